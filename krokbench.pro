@@ -0,0 +1,36 @@
+TARGET = krokbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+
+SOURCES += src/tools/krokbench.cxx \
+    src/tools/KrokEmu.cxx \
+    src/common/Cart.cxx \
+    src/common/TransferStats.cxx \
+    src/common/RetryPolicy.cxx \
+    src/common/CartDetector.cxx \
+    src/common/MD5.cxx \
+    src/common/MappedFile.cxx
+HEADERS += src/tools/KrokEmu.hxx \
+    src/common/Cart.hxx \
+    src/common/TransferStats.hxx \
+    src/common/RetryPolicy.hxx \
+    src/common/CartDetector.hxx \
+    src/common/MappedFile.hxx \
+    src/common/SerialPort.hxx \
+    src/common/bspf.hxx
+
+INCLUDEPATH += src/common src/tools
+OBJECTS_DIR = obj/krokbench
+LIBS += -pthread
+
+unix:!macx {
+    DEFINES += BSPF_UNIX
+    INCLUDEPATH += src/unix
+    SOURCES += src/unix/SerialPortUNIX.cxx \
+        src/unix/Termios2.cxx
+    HEADERS += src/unix/SerialPortUNIX.hxx \
+        src/unix/Termios2.hxx
+}
+QMAKE_CXXFLAGS += -std=c++20
+QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-parameter
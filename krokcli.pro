@@ -0,0 +1,59 @@
+TARGET = krokcli
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+
+SOURCES += src/tools/krokcli.cxx \
+    src/common/CommandLine.cxx \
+    src/common/Cart.cxx \
+    src/common/TransferStats.cxx \
+    src/common/RetryPolicy.cxx \
+    src/common/CartDetector.cxx \
+    src/common/SerialPortManager.cxx \
+    src/common/HotplugMonitor.cxx \
+    src/common/MD5.cxx \
+    src/common/MappedFile.cxx \
+    src/common/MultiFlash.cxx \
+    src/common/KrokDaemon.cxx \
+    src/common/SettingsFile.cxx
+HEADERS += src/common/CommandLine.hxx \
+    src/common/bspf.hxx \
+    src/common/BSType.hxx \
+    src/common/Cart.hxx \
+    src/common/TransferStats.hxx \
+    src/common/RetryPolicy.hxx \
+    src/common/CartDetector.hxx \
+    src/common/SerialPortManager.hxx \
+    src/common/HotplugMonitor.hxx \
+    src/common/SerialPort.hxx \
+    src/common/MultiFlash.hxx \
+    src/common/KrokDaemon.hxx \
+    src/common/Settings.hxx \
+    src/common/Version.hxx \
+    src/common/MultiCart.hxx \
+    src/common/MD5.hxx \
+    src/common/MappedFile.hxx
+
+INCLUDEPATH += src/common
+OBJECTS_DIR = obj/krokcli
+LIBS += -pthread
+
+unix:!macx {
+    DEFINES += BSPF_UNIX
+    INCLUDEPATH += src/unix
+    SOURCES += src/unix/SerialPortUNIX.cxx \
+        src/unix/Termios2.cxx
+    HEADERS += src/unix/SerialPortUNIX.hxx \
+        src/unix/Termios2.hxx
+    target.path = /usr/bin
+    INSTALLS += target
+}
+macx {
+    DEFINES += BSPF_MACOS
+    INCLUDEPATH += src/macos
+    SOURCES += src/macos/SerialPortMACOS.cxx
+    HEADERS += src/macos/SerialPortMACOS.hxx
+    LIBS += -framework CoreFoundation -framework IOKit
+}
+QMAKE_CXXFLAGS += -std=c++20
+QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-parameter
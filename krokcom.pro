@@ -4,21 +4,39 @@ TEMPLATE = app
 SOURCES += src/common/main.cxx \
     src/common/KrokComWindow.cxx \
     src/common/Cart.cxx \
+    src/common/TransferStats.cxx \
+    src/common/RetryPolicy.cxx \
     src/common/CartDetector.cxx \
     src/common/SerialPortManager.cxx \
+    src/common/HotplugMonitor.cxx \
     src/common/MD5.cxx \
+    src/common/MappedFile.cxx \
+    src/common/TransferThread.cxx \
+    src/common/RomScanThread.cxx \
+    src/common/MultiFlash.cxx \
+    src/common/KrokDaemon.cxx \
+    src/common/CommandLine.cxx \
     src/common/AboutDialog.cxx
 HEADERS += src/common/KrokComWindow.hxx \
     src/common/bspf.hxx \
     src/common/BSType.hxx \
     src/common/Cart.hxx \
+    src/common/TransferStats.hxx \
+    src/common/RetryPolicy.hxx \
     src/common/CartDetector.hxx \
     src/common/SerialPortManager.hxx \
+    src/common/HotplugMonitor.hxx \
     src/common/SerialPort.hxx \
     src/common/FindKrokThread.hxx \
+    src/common/TransferThread.hxx \
+    src/common/RomScanThread.hxx \
+    src/common/MultiFlash.hxx \
+    src/common/KrokDaemon.hxx \
+    src/common/CommandLine.hxx \
     src/common/Version.hxx \
     src/common/MultiCart.hxx \
     src/common/MD5.hxx \
+    src/common/MappedFile.hxx \
     src/common/AboutDialog.hxx
 FORMS += src/common/krokcomwindow.ui src/common/aboutdialog.ui
 
@@ -32,8 +50,10 @@ UI_DIR = obj
 unix:!macx {
     DEFINES += BSPF_UNIX
     INCLUDEPATH += src/unix
-    SOURCES += src/unix/SerialPortUNIX.cxx
-    HEADERS += src/unix/SerialPortUNIX.hxx
+    SOURCES += src/unix/SerialPortUNIX.cxx \
+        src/unix/Termios2.cxx
+    HEADERS += src/unix/SerialPortUNIX.hxx \
+        src/unix/Termios2.hxx
     TARGET = krokcom
     target.path = /usr/bin
     docs.path = /usr/share/doc/krokcom
@@ -0,0 +1,22 @@
+TARGET = krokemu
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+
+SOURCES += src/tools/krokemu.cxx \
+    src/tools/KrokEmu.cxx
+HEADERS += src/tools/KrokEmu.hxx \
+    src/common/bspf.hxx
+
+INCLUDEPATH += src/common src/tools
+OBJECTS_DIR = obj/krokemu
+LIBS += -pthread
+
+unix:!macx {
+    DEFINES += BSPF_UNIX
+}
+macx {
+    DEFINES += BSPF_MACOS
+}
+QMAKE_CXXFLAGS += -std=c++20
+QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-parameter
@@ -12,25 +12,34 @@
 // this file, and for a DISCLAIMER OF ALL WARRANTIES.
 //============================================================================
 
+#include <atomic>
 #include <cstring>
+#include <mutex>
+#include <thread>
 
 #include "BSType.hxx"
 #include "Cart.hxx"
 #include "MultiCart.hxx"
 #include "CartDetector.hxx"
+#include "MappedFile.hxx"
+#include "MD5.hxx"
 #include "SerialPort.hxx"
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool Cart::create(const string& filename, const string& type)
 {
-  // Get the cart image
-  memset(myCart, 0, MAXCARTSIZE);
-  myCartSize = readFile(filename, myCart, MAXCARTSIZE);
+  // Get the cart image; only the part of it actually in the file is copied
+  cout << "Reading from file: \'" << filename.c_str() << "\' ... ";
+  MappedFile rom(filename);
+  myCartSize = std::min<uInt32>(rom.size(), MAXCARTSIZE);
+  myImage.assign(rom.data(), rom.data() + myCartSize);
+  myHighBank.clear();
+  cout << "read in " << myCartSize << " bytes" << std::endl;
 
   // Auto-detect the bankswitch type
   if(myType == BS_AUTO || type == "")
   {
-    myType = CartDetector::autodetectType(filename, myCart, myCartSize);
+    myType = CartDetector::autodetectType(filename, rom.data(), myCartSize);
     cout << "Bankswitch type: " << Bankswitch::typeToName(myType).c_str()
          << " (auto-detected)" << std::endl;
   }
@@ -67,17 +76,19 @@ bool Cart::create(const string& filename, const string& type)
   // Pad sub-4K images to minimum size
   if(myType == BS_4K && myCartSize < 4096)
   {
-    padImage(myCart, myCartSize, 4096);
+    myImage.resize(4096);
+    padImage(myImage.data(), myCartSize, 4096);
     myCartSize = 4096;
   }
 
   // 3F and 3E carts need the upper bank in uppermost part of the ROM
-  if(myType == BS_3F || myType == BS_3E)
-    for(int i = 0; i < 2048; i++)
-      myCart[MAXCARTSIZE - 2048 + i] = myCart[myCartSize - 2048 + i];
+  if((myType == BS_3F || myType == BS_3E) && myCartSize >= 2048)
+    myHighBank.assign(myImage.end() - 2048, myImage.end());
 
-  for(uInt32 i = 0; i < MAXCARTSIZE/256; ++i)
-    myModifiedSectors[i] = true;
+  // A partial last sector is sent padded with zeroes
+  myImage.resize((myCartSize + 255) / 256 * 256);
+
+  myModifiedSectors.set();
 
   myIsValid = myCartSize > 0;
   if(myIsValid)
@@ -97,8 +108,9 @@ bool Cart::createMultiFile(const StringList& menuNames, const StringList& fileNa
   myLogMessage = "Invalid cartridge.";
   myCartSize = 0;
   myType = BS_NONE;
-  memset(myCart, 0, MAXCARTSIZE);
-  uInt8 *cart = myCart, menubuffer[13];
+  myImage.clear();
+  myHighBank.clear();
+  uInt8 menubuffer[13];
 
   // Rudimentary consistency check of lists
   if(menuNames.size() != fileNames.size())
@@ -121,10 +133,13 @@ bool Cart::createMultiFile(const StringList& menuNames, const StringList& fileNa
       myLogMessage = "Invalid multicart bankswitch scheme.";
       return false;
   }
-  uInt8* imgbuf = new uInt8[MC_ByteSizes[size]];
+  // Room for the menu and every ROM; trimmed to the ROMs actually used below
+  int numEntries = std::min(int(menuNames.size()), MC_MaxEntries[size]);
+  myImage.assign(size_t(numEntries + 1) * MC_ByteSizes[size], 0);
+  uInt8* cart = myImage.data();
 
   // Add the menu image
-  memcpy(myCart, menuPtr, MC_ByteSizes[size]);
+  memcpy(cart, menuPtr, MC_ByteSizes[size]);
 
   // Set menu title and clear all menu entries
   menuEntry(menubuffer, "- KROKOCART -");
@@ -136,44 +151,67 @@ bool Cart::createMultiFile(const StringList& menuNames, const StringList& fileNa
   cart += MC_ByteSizes[size];
   myCartSize += MC_ByteSizes[size];
 
-  // Scan through each item in the list(s)
-  int numEntries = std::min(int(menuNames.size()), MC_MaxEntries[size]);
+  // Each ROM is read, detected and padded straight into a slot of its own,
+  // several at once, since most of the time is spent waiting on the files
+  const uInt32 slotSize = MC_ByteSizes[size];
+  vector<BSType> imgtypes(numEntries, BS_NONE);
+  std::atomic<int> nextEntry{0};
+  auto loadEntries = [&]()
+  {
+    for(int i = nextEntry++; i < numEntries; i = nextEntry++)
+    {
+      // Only the part of the ROM that fits in a slot is detected (and used)
+      MappedFile rom(fileNames[i]);
+      uInt32 imgsize = std::min(rom.size(), slotSize);
+      imgtypes[i] = CartDetector::autodetectType(fileNames[i], rom.data(), imgsize);
+      if(imgtypes[i] == romType || imgtypes[i] == BS_4K)
+      {
+        uInt8* slot = cart + i * slotSize;
+        memcpy(slot, rom.data(), imgsize);
+        if(imgsize < slotSize)
+          padImage(slot, imgsize, slotSize, false);
+      }
+    }
+  };
+  vector<std::thread> loaders;
+  for(int t = 1; t < std::min(numEntries, MULTIFILE_LOADERS); ++t)
+    loaders.emplace_back(loadEntries);
+  loadEntries();
+  for(auto& loader: loaders)
+    loader.join();
+
+  // Now pack the valid images together, in the order they were given
   int validEntries = 0;
   for(int i = 0; i < numEntries; ++i)
   {
-    int imgsize = readFile(fileNames[i], imgbuf, MC_ByteSizes[size]);
-    BSType imgtype = CartDetector::autodetectType(fileNames[i], imgbuf, imgsize);
-
+    BSType imgtype = imgtypes[i];
     if(imgtype == romType || imgtype == BS_4K)
     {
-      if(imgsize < MC_ByteSizes[size])
-        padImage(imgbuf, imgsize, MC_ByteSizes[size]);
-
-      // Add the image
-      memcpy(cart, imgbuf, MC_ByteSizes[size]);
-      cart += MC_ByteSizes[size];        // Point to position for next cart
-      myCartSize += MC_ByteSizes[size];  // Cart size increases
+      if(validEntries != i)
+        memcpy(cart + validEntries * slotSize, cart + i * slotSize, slotSize);
+      myCartSize += slotSize;  // Cart size increases
       ++validEntries;
 
       // Add menu entry
       menuEntry(menubuffer, menuNames[i]);
       for (int charpos = 0; charpos < 13; ++charpos)
-        myCart[MC_MenuOffset[size] + ((validEntries) * 13) + charpos] =
+        myImage[MC_MenuOffset[size] + ((validEntries) * 13) + charpos] =
             menubuffer[charpos];
     }
     else
       cout << "Multicart image " << i << " skipped; invalid bankswitch type \'"
            << Bankswitch::typeToName(imgtype).c_str() << "\'" << std::endl;
   }
-  delete[] imgbuf;
+  myImage.resize(myCartSize);
+  myImage.shrink_to_fit();
 
   // Set PAL/NTSC
   cout << "Setting " << (ntsc ? "NTSC" : "PAL") << " multicart menu type." << std::endl;
-  myCart[MC_MenuOffset[size] + 2046] = ntsc ? 128 : 0;
+  myImage[MC_MenuOffset[size] + 2046] = ntsc ? 128 : 0;
 
   // Set number of menu entries
   cout << "Multicart has " << validEntries << " menu entries." << std::endl;
-  myCart[MC_MenuOffset[size] + 2047] = (uInt8)validEntries;
+  myImage[MC_MenuOffset[size] + 2047] = (uInt8)validEntries;
 
   myIsValid = validEntries > 0;
 
@@ -183,14 +221,15 @@ bool Cart::createMultiFile(const StringList& menuNames, const StringList& fileNa
   {
     if(romfile != "")
     {
-      if(writeFile(romfile, myCart, myCartSize) == 0)
+      if(writeFile(romfile, myImage.data(), myCartSize) == 0)
       {
         myLogMessage = "Couldn't open multicart output file.";
         return false;
       }
 
       // Add info for this ROM to the database, since autodetection won't know what it is
-      CartDetector::addRomInfo(romfile, type, myCart, myCartSize);
+      CartDetector::addRomInfo(type, myImage.data(), myCartSize);
+      CartDetector::saveRomInfo();
     }
 
     buf << (ntsc ? "NTSC" : "PAL") << " multicart created with " << validEntries << " entries";
@@ -213,6 +252,20 @@ bool Cart::createMultiFile(const StringList& menuNames, const StringList& fileNa
 uInt16 Cart::initSectors(bool downloadMode)
 {
   myCurrentSector = 0;
+  mySectorCount = 0;
+  myPendingSectors.clear();
+  myUnconfirmedSectors.clear();
+  myUnverifiedSectors.clear();
+  myStagedFrames.clear();
+  myStagedSent = 0;
+  myStats.reset(downloadMode);
+
+  // A link given up on in an earlier pass may be back (or may be a
+  // different KrokCart), so start out with no assumptions about it
+  myWritePolicy.reset();
+  myReadPolicy.reset();
+  mySectorRetries.assign(MAXCARTSIZE/256, 0);
+  mySectorResent.reset();
 
   if(myIsValid)
   {
@@ -220,39 +273,80 @@ uInt16 Cart::initSectors(bool downloadMode)
     if(myType == BS_3F || myType == BS_3E)  // 3F and 3E add 8 more (2040 - 2047)
       myNumSectors += 8;
 
-    for(uInt32 i = 0; i < MAXCARTSIZE/256; ++i)
-      myModifiedSectors[i] = true;
+    myModifiedSectors.set();
 
     // Determine which sectors should be written to the KrokCart
     if(downloadMode)
     {
       ostringstream out;
+      myImageMD5 = imageMD5();
+      mySectorsDone.reset();
+      myDoneSinceJournal = 0;
+      myResumed = false;
       if(myIncremental)
       {
-        // Read the last rom written
-        uInt8 buffer[MAXCARTSIZE];
-        memset(buffer, 0, MAXCARTSIZE);
-        readFile(ourLastCart, buffer, MAXCARTSIZE, false);
-
-        // Determine which 256 byte blocks differ
-        int count = 0;
-        uInt8 *cart = myCart, *buf = buffer;
-        for(uInt32 i = 0; i < myCartSize/256; ++i, cart += 256, buf += 256)
+        // Compare against the digests of what is already on the KrokCart
+        uInt64 digests[MAXCARTSIZE/256];
         {
-          myModifiedSectors[i] = memcmp(cart, buf, 256) != 0;
-          if(myModifiedSectors[i])  ++count;
+          std::lock_guard<std::mutex> lock(ourLastCartMutex);
+          readManifest(digests);
         }
 
-        out << "Incremental download mode, " << count << " / "
-            << (myCartSize/256) << " sectors are changed.";
-        myLogMessage = out.str();
+        // Determine which 256 byte blocks differ
+        for(uInt32 i = 0; i < MAXCARTSIZE/256; ++i)
+          myModifiedSectors[i] = sectorDigest(i) != digests[i];
       }
-      else
+
+      // Pick up where an interrupted download of this image left off
+      if(myResume)
       {
+        std::lock_guard<std::mutex> lock(ourLastCartMutex);
+        myResumed = readJournal(mySectorsDone);
+      }
+      if(myResumed)
+        myModifiedSectors &= ~mySectorsDone;
+
+      if(myResumed)
+        out << "Resuming interrupted download, " << countSectors(myModifiedSectors)
+            << " / " << myNumSectors << " sectors left to write.";
+      else if(myIncremental)
+        out << "Incremental download mode, " << countSectors(myModifiedSectors)
+            << " / " << (myCartSize/256) << " sectors are changed.";
+      else
         out << "Normal download mode, " << myNumSectors << " / "
             << (myCartSize/256) << " sectors are changed.";
-        myLogMessage = out.str();
+      myLogMessage = out.str();
+      cout << myLogMessage.c_str() << std::endl;
+    }
+    // Determine which sectors should be read back from the KrokCart
+    else if(myVerifyChanged)
+    {
+      // Only sectors written by the last download need checking, as long
+      // as this is the image that was downloaded to this device, and a
+      // periodic full verify isn't due
+      bool changedOnly = false;
+      {
+        std::lock_guard<std::mutex> lock(ourLastCartMutex);
+        auto last = ourLastWritten.find(myDevice);
+        if(last != ourLastWritten.end() && last->second.md5 == imageMD5())
+        {
+          changedOnly = true;
+          if(myFullVerifyInterval > 0 && ++ourChangedVerifies >= myFullVerifyInterval)
+          {
+            changedOnly = false;
+            ourChangedVerifies = 0;
+          }
+        }
+        if(changedOnly)
+          myModifiedSectors = last->second.sectors;
       }
+
+      ostringstream out;
+      if(changedOnly)
+        out << "Verifying changed sectors only, " << countSectors(myModifiedSectors) << " / " << myNumSectors << " sectors were written.";
+      else
+        out << "Full verify, " << myNumSectors << " sectors.";
+      myLogMessage = out.str();
       cout << myLogMessage.c_str() << std::endl;
     }
   }
@@ -267,30 +361,59 @@ uInt16 Cart::writeNextSector(SerialPort& port)
 {
   if(!myIsValid)
     throw "write: Invalid cart";
-  else if(myCurrentSector == myNumSectors)
+  else if(mySectorCount == myNumSectors)
     throw "write: All sectors already written";
 
   uInt16 sector = myCurrentSector;
-  uInt32 retry = 0;
 
-  // Only write the sector if it has changed
-  if(!myIncremental || myModifiedSectors[sector])
+  // Only write the sector if it has changed, and isn't already there
+  if(myModifiedSectors[sector])
   {
-    bool status;
-    while(!(status = downloadSector(sector, port)) && retry++ < myRetry)
-      cout << "Write transmission of sector " <<  sector << " failed, retry " << retry << std::endl;
-    if(!status)
-      throw "write: failed max retries";
+    queueSector(sector);
+
+    // Once the window is full, everything queued goes out in one batch,
+    // and we must wait for the oldest sector to be acknowledged before
+    // sending any more
+    if(myPendingSectors.size() >= myWindow)
+    {
+      sendQueuedSectors(port);
+      if(myVerifyWrites)
+      {
+        // Read commands can't be mixed with writes still in flight, so
+        // the whole window is acknowledged before it is read back
+        flushSectors(port);
+        verifyWrittenSectors(port);
+      }
+      else
+      {
+        while(myPendingSectors.size() >= myWindow)
+          collectSectorAck(port);
+
+        // Let the window empty now and then, so a lost ack is noticed
+        // (and the sectors it affects are re-sent) before too long
+        if(myUnconfirmedSectors.size() >= CONFIRM_INTERVAL)
+          flushSectors(port);
+      }
+    }
   }
 
   // Handle 3F and 3E carts, which are a little different from the rest
   // There are two ranges of sectors; the second starts once we past the
   // cart size
   myCurrentSector++;
+  mySectorCount++;
   if((myType == BS_3F || myType == BS_3E) &&
       myCurrentSector == myCartSize / 256)
     myCurrentSector = 2040;
 
+  // Everything has been sent; wait for the remaining acknowledgements
+  if(mySectorCount == myNumSectors)
+  {
+    flushSectors(port);
+    if(myVerifyWrites)
+      verifyWrittenSectors(port);
+  }
+
   return sector;
 }
 
@@ -299,22 +422,33 @@ uInt16 Cart::verifyNextSector(SerialPort& port)
 {
   if(!myIsValid)
     throw "verify: Invalid cart";
-  else if(myCurrentSector == myNumSectors)
+  else if(mySectorCount == myNumSectors)
     throw "verify: All sectors already verified";
 
   uInt16 sector = myCurrentSector;
   uInt32 retry = 0;
 
-  bool status;
-  while(!(status = verifySector(sector, port)) && retry++ < myRetry)
+  // Only read the sector if it may have changed
+  bool status = true;
+  while(myModifiedSectors[sector] &&
+        !(status = verifySector(sector, port, retry > 0)) && !port.isLost() &&
+        !myReadPolicy.dead() && retry++ < myRetry)
+  {
+    myStats.retry(sector);
     cout << "Read transmission of sector " <<  sector << " failed, retry " << retry << std::endl;
-  if(!status)
+  }
+  if(port.isLost())
+    throw "verify: KrokCart disconnected";
+  else if(myReadPolicy.dead())
+    throw "verify: KrokCart not responding";
+  else if(!status)
     throw "verify: failed max retries";
 
   // Handle 3F and 3E carts, which are a little different from the rest
   // There are two ranges of sectors; the second starts once we past the
   // cart size
   myCurrentSector++;
+  mySectorCount++;
   if((myType == BS_3F || myType == BS_3E) &&
       myCurrentSector == myCartSize / 256)
     myCurrentSector = 2040;
@@ -323,57 +457,287 @@ uInt16 Cart::verifyNextSector(SerialPort& port)
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-bool Cart::finalizeSectors()
+void Cart::flushSectors(SerialPort& port)
 {
-  bool status = false;
-  ostringstream out;
-  if(myCurrentSector == myNumSectors)
+  sendQueuedSectors(port);
+  while(!myPendingSectors.empty())
+    collectSectorAck(port);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::verifyWrittenSectors(SerialPort& port)
+{
+  while(!myUnverifiedSectors.empty())
   {
-    if(myIncremental)
+    uInt16 sector = myUnverifiedSectors.front();
+    myUnverifiedSectors.pop_front();
+
+    if(verifySector(sector, port, mySectorRetries[sector] > 0))
     {
-      int count = 0;
-      for(uInt32 i = 0; i < myCartSize/256; ++i)
-        if(myModifiedSectors[i])  ++count;
+      sectorDone(sector);
+      continue;
+    }
 
-      out << "Incremental download complete, wrote " << count << " / " << myNumSectors << " sectors.";
+    // Report the sector that actually failed, not the iterator position
+    if(port.isLost())
+    {
+      myCurrentSector = sector;
+      myUnverifiedSectors.clear();
+      throw "write: KrokCart disconnected";
     }
+    else if(myReadPolicy.dead())
+    {
+      myCurrentSector = sector;
+      myUnverifiedSectors.clear();
+      throw "write: KrokCart not responding";
+    }
+    else if(++mySectorRetries[sector] > myRetry)
+    {
+      myCurrentSector = sector;
+      myUnverifiedSectors.clear();
+      throw "write: verify failed max retries";
+    }
+    myStats.retry(sector);
+    cout << "Verify of written sector " <<  sector << " failed, rewriting, retry "
+         << int(mySectorRetries[sector]) << std::endl;
+
+    // Once acknowledged, the sector is queued to be read back again
+    queueSector(sector);
+    flushSectors(port);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool Cart::finalizeSectors()
+{
+  bool status = false;
+  ostringstream out;
+  // A transfer that failed while waiting for the last acks has still
+  // iterated over every sector, so check that each one is really done
+  if(mySectorCount == myNumSectors && myPendingSectors.empty() &&
+     myUnverifiedSectors.empty() &&
+     countSectors(myModifiedSectors & ~mySectorsDone) == 0)
+  {
+    if(myResumed)
+      out << "Resumed download complete, wrote " << countSectors(myModifiedSectors)
+          << " / " << myNumSectors << " sectors";
+    else if(myIncremental)
+      out << "Incremental download complete, wrote " << countSectors(myModifiedSectors)
+          << " / " << myNumSectors << " sectors";
     else
-      out << "Download complete, wrote " << myNumSectors << " sectors.";
+      out << "Download complete, wrote " << myNumSectors << " sectors";
+    out << (myVerifyWrites ? ", all verified." : ".");
+
+    // Record what is now on the KrokCart, for comparison next time
+    // (several carts may be finishing at the same time)
+    std::lock_guard<std::mutex> lock(ourLastCartMutex);
+    updateManifest();
 
-    // Write out the current ROM to use for comparison next time
-    writeFile(ourLastCart, myCart, MAXCARTSIZE, false);
+    // Remember what was written (including by an interrupted download
+    // this one resumed), so a verify can check only those sectors
+    ourLastWritten[myDevice] = { myImageMD5, mySectorsDone };
+
+    // Nothing left to resume
+    writeJournal(nullptr);
 
     status = true;
   }
   else
+  {
     out <<  "Download failure on sector " << myCurrentSector << ".";
 
+    // The KrokCart now holds some sectors of this image, and the rest of
+    // whatever was there before; record which are which, so the next
+    // attempt can resume, and incremental mode compares against what is
+    // actually there
+    std::lock_guard<std::mutex> lock(ourLastCartMutex);
+    writeJournal(&mySectorsDone);
+    updateManifest();
+  }
+
   myLogMessage = out.str();
   return status;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-uInt32 Cart::readFile(const string& filename, uInt8* buffer, uInt32 maxSize,
-                      bool showmessage) const
+void Cart::sectorDone(uInt16 sector)
 {
-  if(showmessage) cout << "Reading from file: \'" << filename.c_str() << "\' ... ";
+  mySectorsDone[sector] = true;
+  if(++myDoneSinceJournal >= JOURNAL_INTERVAL)
+  {
+    std::lock_guard<std::mutex> lock(ourLastCartMutex);
+    writeJournal(&mySectorsDone);
+    myDoneSinceJournal = 0;
+  }
+}
 
-  // Read file into buffer
-  std::ifstream in(filename, std::ios::binary);
-  if(!in)
-    return 0;
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt16 Cart::countSectors(const SectorSet& sectors) const
+{
+  // 3F and 3E carts also use the last 8 sectors (2040 - 2047)
+  uInt16 count = 0;
+  for(uInt32 i = 0; i < myCartSize/256; ++i)
+    if(sectors[i])  ++count;
+  if(myType == BS_3F || myType == BS_3E)
+    for(uInt32 i = 2040; i < MAXCARTSIZE/256; ++i)
+      if(sectors[i])  ++count;
 
-  // Figure out how much data we should read
-  in.seekg(0, std::ios::end);
-  std::streampos length = in.tellg();
-  in.seekg(0, std::ios::beg);
-  uInt32 size = length > maxSize ? maxSize : uInt32(length);
+  return count;
+}
 
-  in.read((char*)buffer, size);
-  if(showmessage) cout << "read in " << size << " bytes" << std::endl;
-  in.close();
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+const uInt8* Cart::sectorData(uInt16 sector) const
+{
+  // Everything outside the image is left blank
+  static constexpr uInt8 EMPTY_SECTOR[256] = { 0 };
 
-  return size;
+  if(sector >= 2040 && !myHighBank.empty())
+    return myHighBank.data() + (sector - 2040) * 256;
+  else if(sector < myImage.size() / 256)
+    return myImage.data() + sector * 256;
+  else
+    return EMPTY_SECTOR;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string Cart::imageMD5() const
+{
+  // The upper bank copy (if any) gets a digest of its own, rather than
+  // hashing the whole address space in between
+  string md5 = MD5(myImage.data(), uInt32(myImage.size()));
+  if(!myHighBank.empty())
+    md5 += MD5(myHighBank.data(), uInt32(myHighBank.size()));
+
+  return md5;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt64 Cart::sectorDigest(uInt16 sector) const
+{
+  // The first half of the MD5 is plenty to tell sectors apart; zero is
+  // reserved for sectors whose contents aren't known
+  uInt8 md5[16];
+  MD5(sectorData(sector), 256, md5);
+
+  uInt64 digest;
+  memcpy(&digest, md5, sizeof(digest));
+  return digest != 0 ? digest : 1;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool Cart::readManifest(uInt64* digests) const
+{
+  // The file is a short header, followed by the digest of each sector
+  memset(digests, 0, MAXCARTSIZE/256 * sizeof(uInt64));
+
+  std::ifstream in(ourManifest, std::ios::binary);
+  char magic[sizeof(MANIFEST_MAGIC)];
+  if(!in.read(magic, sizeof(magic)) || memcmp(magic, MANIFEST_MAGIC, sizeof(magic)) != 0 ||
+     !in.read(reinterpret_cast<char*>(digests), MAXCARTSIZE/256 * sizeof(uInt64)))
+  {
+    memset(digests, 0, MAXCARTSIZE/256 * sizeof(uInt64));
+    return false;
+  }
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::updateManifest() const
+{
+  if(ourManifest == "")
+    return;
+
+  // Only the sectors that reached the KrokCart have changed
+  uInt64 digests[MAXCARTSIZE/256];
+  readManifest(digests);
+  for(uInt32 i = 0; i < MAXCARTSIZE/256; ++i)
+    if(mySectorsDone[i])
+      digests[i] = sectorDigest(i);
+
+  std::ofstream out(ourManifest, std::ios::binary);
+  out.write(MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+  out.write(reinterpret_cast<const char*>(digests), sizeof(digests));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool Cart::readJournal(SectorSet& done) const
+{
+  if(ourJournal == "" || myDevice == "")
+    return false;
+
+  // Each line is: <image MD5> <bankswitch type> <sectors> <device>
+  // where the sectors done are a bitmap, as one hex digit per 4 sectors
+  std::ifstream in(ourJournal);
+  string line;
+  while(std::getline(in, line))
+  {
+    std::istringstream entry(line);
+    string md5, type, sectors, device;
+    entry >> md5 >> type >> sectors;
+    std::getline(entry >> std::ws, device);
+    if(device != myDevice)
+      continue;
+
+    // Only the latest download to each device is kept
+    if(md5 != myImageMD5 || type != Bankswitch::typeToName(myType) ||
+       sectors.size() != MAXCARTSIZE/256/4)
+      return false;
+
+    static const string hex = "0123456789abcdef";
+    for(uInt32 i = 0; i < MAXCARTSIZE/256; i += 4)
+    {
+      size_t bits = hex.find(sectors[i/4]);
+      if(bits == string::npos)
+        return false;
+      for(uInt32 j = 0; j < 4; ++j)
+        done[i+j] = (bits >> j) & 1;
+    }
+    return true;
+  }
+  return false;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::writeJournal(const SectorSet* done) const
+{
+  if(ourJournal == "" || myDevice == "")
+    return;
+
+  // Keep the entries for all other devices
+  StringList entries;
+  {
+    std::ifstream in(ourJournal);
+    string line;
+    while(std::getline(in, line))
+    {
+      std::istringstream entry(line);
+      string md5, type, sectors, device;
+      entry >> md5 >> type >> sectors;
+      std::getline(entry >> std::ws, device);
+      if(device != myDevice && device != "")
+        entries.push_back(line);
+    }
+  }
+
+  if(done)
+  {
+    ostringstream entry;
+    entry << myImageMD5 << " " << Bankswitch::typeToName(myType) << " ";
+    for(uInt32 i = 0; i < MAXCARTSIZE/256; i += 4)
+      entry << "0123456789abcdef"[(*done)[i] | (*done)[i+1] << 1 |
+                                  (*done)[i+2] << 2 | (*done)[i+3] << 3];
+    entry << " " << myDevice;
+    entries.push_back(entry.str());
+  }
+
+  if(entries.empty())
+  {
+    std::remove(ourJournal.c_str());
+    return;
+  }
+  std::ofstream out(ourJournal);
+  for(const auto& entry: entries)
+    out << entry << std::endl;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -395,12 +759,13 @@ uInt32 Cart::writeFile(const string& filename, uInt8* buffer, uInt32 size,
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void Cart::padImage(uInt8* buffer, uInt32 bufsize, uInt32 requiredsize) const
+void Cart::padImage(uInt8* buffer, uInt32 bufsize, uInt32 requiredsize,
+                    bool showmessage) const
 {
   // Pad buffer to minimum size, aligning to power-of-2 boundary
   if(bufsize < requiredsize)
   {
-    cout << "  Converting to " << (requiredsize/1024) << "K." << std::endl;
+    if(showmessage) cout << "  Converting to " << (requiredsize/1024) << "K." << std::endl;
 
     // Determine power-of-2 boundary
     uInt32 power2 = 1;
@@ -418,53 +783,278 @@ void Cart::padImage(uInt8* buffer, uInt32 bufsize, uInt32 requiredsize) const
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-bool Cart::downloadSector(uInt32 sector, SerialPort& port) const
+void Cart::queueSector(uInt16 sector)
 {
-  uInt8 buffer[262];
+  stageSector(sector);
+  myPendingSectors.push_back(sector);
+}
 
-  buffer[0] = 1;                             // Mark start of command
-  buffer[1] = 0;                             // Command # for 'Download Sector'
-  buffer[2] = (uInt8)((sector >> 8) & 0xff); // Sector # Hi-Byte
-  buffer[3] = (uInt8)sector;                 // Sector # Lo-Byte
-  buffer[4] = (uInt8)myType;                 // Bankswitching mode
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::sendQueuedSectors(SerialPort& port)
+{
+  if(myStagedFrames.empty())
+    return;
 
-  uInt8 chksum = 0;
-  for(int i = 0; i < 256; i++)
-    buffer[5+i] = myCart[(sector*256) + i];
-  for(int i = 2; i < 261; i++)
-    chksum ^= buffer[i];
-  buffer[261] = chksum;
+  while(!sendStagedSectors(port))
+  {
+    // Report the sector that actually failed (the one the write stopped
+    // in), not the iterator position
+    uInt16 sector = myStagedFrames[myStagedSent / 262].sector;
+    if(port.isLost())
+    {
+      myCurrentSector = sector;
+      myPendingSectors.clear();
+      myStagedFrames.clear();
+      myStagedSent = 0;
+      throw "write: KrokCart disconnected";
+    }
+    else if(++mySectorRetries[sector] > myRetry)
+    {
+      myCurrentSector = sector;
+      myPendingSectors.clear();
+      myStagedFrames.clear();
+      myStagedSent = 0;
+      throw "write: failed max retries";
+    }
+    myStats.retry(sector);
+    cout << "Write transmission of sector " <<  sector << " failed, retry "
+         << int(mySectorRetries[sector]) << std::endl;
+  }
+  myStagedFrames.clear();
+  myStagedSent = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::collectSectorAck(SerialPort& port)
+{
+  // Acks are returned in the same order the sectors were sent
+  uInt16 sector = myPendingSectors.front();
+  myPendingSectors.pop_front();
+
+  Reply reply = receiveSectorAck(sector, port);
+  if(reply == ReplyOK)
+  {
+    // Once nothing is in flight, the number of acks matches the number
+    // of sectors sent, so none can have been lost
+    myUnconfirmedSectors.push_back(sector);
+    if(myPendingSectors.empty())
+    {
+      for(auto s: myUnconfirmedSectors)
+      {
+        if(myVerifyWrites)
+          myUnverifiedSectors.push_back(s);  // Not done until read back
+        else
+          sectorDone(s);
+      }
+      myUnconfirmedSectors.clear();
+    }
+  }
+  else
+  {
+    // Report the sector that actually failed, not the iterator position
+    if(port.isLost())
+    {
+      myCurrentSector = sector;
+      myPendingSectors.clear();
+      throw "write: KrokCart disconnected";
+    }
+    else if(myWritePolicy.dead())
+    {
+      myCurrentSector = sector;
+      myPendingSectors.clear();
+      throw "write: KrokCart not responding";
+    }
+    else if(++mySectorRetries[sector] > myRetry)
+    {
+      myCurrentSector = sector;
+      myPendingSectors.clear();
+      throw "write: failed max retries";
+    }
+    myStats.retry(sector);
+    cout << "Write transmission of sector " <<  sector << " failed, retry "
+         << int(mySectorRetries[sector]) << std::endl;
+
+    if(reply == ReplyTimeout)
+    {
+      // An ack has been lost, but not necessarily this one; any ack
+      // since the window was last empty may have been matched to the
+      // wrong sector.  Wait for the line to go quiet, then send all
+      // those sectors again, along with the ones still in flight.  They
+      // go one at a time, so there is no doubt about which ack is which
+      // (and another lost ack is blamed on the right sector).
+      drainReplies(port, myWritePolicy);
+      std::deque<uInt16> resend;
+      resend.swap(myUnconfirmedSectors);
+      resend.push_back(sector);
+      resend.insert(resend.end(), myPendingSectors.begin(), myPendingSectors.end());
+      myPendingSectors.clear();
+      for(auto s: resend)
+      {
+        if(s != sector)
+          mySectorResent[s] = true;
+        queueSector(s);
+        flushSectors(port);
+      }
+    }
+    else  // Only this sector is re-sent; the ones in flight are unaffected
+    {
+      queueSector(sector);
+      sendQueuedSectors(port);
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::drainReplies(SerialPort& port, const RetryPolicy& policy)
+{
+  uInt8 discard[64];
+  while(port.receive(discard, sizeof(discard), policy.quietTime()) > 0 && !port.isLost())
+    ;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::forgetDevice(const string& device)
+{
+  std::lock_guard<std::mutex> lock(ourLastCartMutex);
+  ourLastWritten.erase(device);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::resyncRead(SerialPort& port)
+{
+  drainReplies(port, myReadPolicy);
+
+  uInt8 ack = 0;
+  myStats.sent(port.send(&ack, 1), TransferStats::Clock::duration(0));
+}
 
-  // Write sector to serial port
-  if(port.send(buffer, 262) != 262)
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt8 Cart::checksum(const uInt8* data, uInt32 size)
+{
+  // XOR eight bytes at a time, then fold the result down to one byte
+  uInt64 sum = 0;
+  uInt32 i = 0;
+  for(; i + 8 <= size; i += 8)
   {
-    cout << "Transmission error in downloadSector" << std::endl;
+    uInt64 word;
+    memcpy(&word, data + i, 8);
+    sum ^= word;
+  }
+  sum ^= sum >> 32;
+  sum ^= sum >> 16;
+  sum ^= sum >> 8;
+
+  uInt8 result = uInt8(sum);
+  for(; i < size; ++i)
+    result ^= data[i];
+
+  return result;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::stageSector(uInt16 sector)
+{
+  Frame frame;
+  frame.header[0] = 1;                             // Mark start of command
+  frame.header[1] = 0;                             // Command # for 'Download Sector'
+  frame.header[2] = (uInt8)((sector >> 8) & 0xff); // Sector # Hi-Byte
+  frame.header[3] = (uInt8)sector;                 // Sector # Lo-Byte
+  frame.header[4] = (uInt8)myType;                 // Bankswitching mode
+  frame.sector = sector;
+
+  // The checksum covers everything after the command bytes
+  frame.trailer = frame.header[2] ^ frame.header[3] ^ frame.header[4] ^
+                  checksum(sectorData(sector), 256);
+
+  myStagedFrames.push_back(frame);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool Cart::sendStagedSectors(SerialPort& port)
+{
+  // Each sector is sent as header, data (straight from the image) and
+  // checksum; the whole batch goes out in one write
+  mySegments.clear();
+  for(const auto& frame: myStagedFrames)
+  {
+    mySegments.push_back({frame.header, 5});
+    mySegments.push_back({sectorData(frame.sector), 256});
+    mySegments.push_back({&frame.trailer, 1});
+    myStats.sectorStarted(frame.sector);
+  }
+  uInt32 size = uInt32(myStagedFrames.size()) * 262;
+
+  // After a short write, carry on from where the last attempt stopped;
+  // the KrokCart has already received everything before that point
+  auto segment = mySegments.begin();
+  for(uInt32 skip = myStagedSent; skip > 0; )
+  {
+    uInt32 len = std::min(skip, segment->size);
+    segment->data = (const uInt8*)segment->data + len;
+    segment->size -= len;
+    skip -= len;
+    if(segment->size == 0)
+      ++segment;
+  }
+
+  // Write sectors to serial port
+  auto start = TransferStats::Clock::now();
+  uInt32 sent = port.send(&*segment, uInt32(mySegments.end() - segment));
+  myStats.sent(sent, TransferStats::Clock::now() - start);
+  myStagedSent += sent;
+  if(myStagedSent != size)
+  {
+    cout << "Transmission error in sendStagedSectors" << std::endl;
     return false;
   }
+  return true;
+}
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+Cart::Reply Cart::receiveSectorAck(uInt32 sector, SerialPort& port)
+{
   // Check return code of sector write
   uInt8 result = 0;
-  port.receive(&result, 1);
+  auto start = TransferStats::Clock::now();
+  uInt32 received = port.receive(&result, 1, myWritePolicy.timeout());
+  myStats.received(received, TransferStats::Clock::now() - start);
 
   // Check return code
-  if(result == 0x7c)
+  if(received == 0)
   {
+    myStats.timeout();
+    myWritePolicy.timedOut();
+    cout << "Timeout waiting for sector " << sector << std::endl;
+    return ReplyTimeout;
+  }
+  else if(result == 0x7c)
+  {
+    myStats.checksumError();
+    myWritePolicy.replied();
     cout << "Checksum Error for sector " << sector << std::endl;
-    return false;
+    return ReplyError;
   }
   else if(result == 0xff)
   {
-    return true;
+    // Only sectors sent exactly once give an unambiguous round-trip time
+    uInt32 usec = myStats.sectorFinished(sector);
+    if(mySectorRetries[sector] == 0 && !mySectorResent[sector])
+      myWritePolicy.sample(usec);
+    else
+      myWritePolicy.replied();
+    return ReplyOK;
   }
   else
   {
+    myStats.undefinedResponse();
+    myWritePolicy.replied();
     cout << "Undefined response " << (int)result << " for sector " << sector << std::endl;
-    return false;
+    return ReplyError;
   }
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-bool Cart::verifySector(uInt32 sector, SerialPort& port) const
+bool Cart::verifySector(uInt32 sector, SerialPort& port, bool resent)
 {
   uInt8 buffer[257];
 
@@ -478,7 +1068,11 @@ bool Cart::verifySector(uInt32 sector, SerialPort& port) const
   buffer[4] = chksum;                        // Chksum
 
   // Write command to serial port
-  if(port.send(buffer, 5) != 5)
+  myStats.sectorStarted(sector);
+  auto start = TransferStats::Clock::now();
+  uInt32 sent = port.send(buffer, 5);
+  myStats.sent(sent, TransferStats::Clock::now() - start);
+  if(sent != 5)
   {
     cout << "Write transmission error of command in verifySector" << std::endl;
     return false;
@@ -486,41 +1080,74 @@ bool Cart::verifySector(uInt32 sector, SerialPort& port) const
 
   // Check return code of command write
   uInt8 result = 0;
-  port.receive(&result, 1);
+  start = TransferStats::Clock::now();
+  uInt32 received = port.receive(&result, 1, myReadPolicy.timeout());
+  myStats.received(received, TransferStats::Clock::now() - start);
 
   // Check return code
-  if(result == 0x00)
+  if(received == 0)
   {
+    myStats.timeout();
+    myReadPolicy.timedOut();
+    cout << "Timeout waiting for verify sector " << sector << std::endl;
+    resyncRead(port);  // In case the reply is only late
+    return false;
+  }
+  else if(result == 0x00)
+  {
+    myStats.checksumError();
+    myReadPolicy.replied();
     cout << "Checksum Error for verify sector " << sector << std::endl;
     return false;
   }
   else if(result != 0xfe)
   {
+    myStats.undefinedResponse();
+    myReadPolicy.replied();
     cout << "Undefined response " << (int)result << " for sector " << sector << std::endl;
+    resyncRead(port);  // We're out of step with the KrokCart
     return false;
   }
 
   // Now it's safe to read the sector (256 data bytes + 1 chksum)
-  int BytesRead = 0;
-  do
+  // The whole frame is read in bulk, with one deadline for all of it
+  start = TransferStats::Clock::now();
+  received = port.receive(buffer, 257, myReadPolicy.timeout());
+  myStats.received(received, TransferStats::Clock::now() - start);
+  if(received != 257)
   {
-    uInt8 data = 0;
-    if(port.receive(&data, 1) == 1)
-      buffer[BytesRead++] = data;
+    myStats.timeout();
+    myReadPolicy.timedOut();
+    cout << "Timeout reading back sector " << sector << std::endl;
+    resyncRead(port);  // Discard any partial frame before a retry
+    return false;
   }
-  while(BytesRead < 257);
-  port.send(buffer, 1);  // Send an Ack
+  myStats.sent(port.send(buffer, 1), TransferStats::Clock::duration(0));  // Send an Ack
 
   // Make sure the data chksum matches
-  chksum = 0;
-  for(int i = 0; i < 256; ++i)
-    chksum ^= buffer[i];
-  if(chksum != buffer[256])
+  myReadPolicy.replied();
+  if(checksum(buffer, 256) != buffer[256])
+  {
+    myStats.checksumError();
     return false;
+  }
 
   // Now that we have a valid sector read back from the device,
   // compare to the actual data to make sure they match
-  return memcmp(myCart + sector*256, &buffer, 256) == 0;
+  if(memcmp(sectorData(sector), &buffer, 256) != 0)
+  {
+    myStats.dataMismatch();
+    cout << "Data mismatch for verify sector " << sector << std::endl;
+    resyncRead(port);  // This may have been a late reply to an earlier read
+    return false;
+  }
+
+  uInt32 usec = myStats.sectorFinished(sector);
+  if(!resent)
+    myReadPolicy.sample(usec);
+  else
+    myReadPolicy.replied();
+  return true;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -556,4 +1183,8 @@ void Cart::menuEntry(uInt8* menuentry, const string& menuname) const
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-string Cart::ourLastCart = "";
+string Cart::ourManifest = "";
+string Cart::ourJournal = "";
+std::mutex Cart::ourLastCartMutex;
+std::map<string, Cart::LastWrite> Cart::ourLastWritten;
+uInt32 Cart::ourChangedVerifies = 0;
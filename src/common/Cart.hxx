@@ -18,9 +18,16 @@
 // 2048 sectors of 256 bytes each
 #define MAXCARTSIZE 2048*256
 
+#include <bitset>
+#include <deque>
+#include <map>
+#include <mutex>
+
 #include "bspf.hxx"
 #include "BSType.hxx"
+#include "RetryPolicy.hxx"
 #include "SerialPort.hxx"
+#include "TransferStats.hxx"
 
 /**
  *
@@ -35,6 +42,15 @@ class Cart
     */
     Cart() = default;
 
+    /**
+      A cart only holds as much of the image as the ROM actually uses,
+      so copies are cheap for small ROMs, and moves are always cheap.
+    */
+    Cart(const Cart&) = default;
+    Cart(Cart&&) = default;
+    Cart& operator=(const Cart&) = default;
+    Cart& operator=(Cart&&) = default;
+
   public:
     /**
       Loads cartridge data from the given filename, creating a cart.
@@ -71,6 +87,11 @@ class Cart
       Write the next sector in the iterator to the serial port,
       returning the actual sector number that was written.
 
+      When the download window is larger than one, the sector is only
+      queued for acknowledgement; the acks are collected as more sectors
+      are written, and all outstanding acks are collected when the last
+      sector in the iterator is written.
+
       NOTE: After calling initSectors(), DO NOT mix calls to
             writeNextSector() and verifyNextSector().
 
@@ -91,6 +112,13 @@ class Cart
     */
     uInt16 verifyNextSector(SerialPort& port);
 
+    /**
+      Wait for the KrokCart to acknowledge all sectors still in flight.
+      This is only needed when a download is stopped before the last
+      sector is written; an exception is thrown on any errors.
+    */
+    void flushSectors(SerialPort& port);
+
     /**
       Finalizes the sector iterator after all sectors have been downloaded.
 
@@ -113,9 +141,55 @@ class Cart
     bool getIncremental() const      { return myIncremental;   }
     void setIncremental(bool enable) { myIncremental = enable; }
 
+    /**
+      Set whether a verify reads back only the sectors written by the last
+      download (when verifying the same image), rather than every sector.
+      Every 'fullInterval' such verifies, all sectors are read anyway
+      (0 means never).
+    */
+    void setVerifyChanged(bool enable, uInt32 fullInterval = 0) {
+      myVerifyChanged = enable;
+      myFullVerifyInterval = fullInterval;
+    }
+
+    /**
+      Set whether each sector is read back as soon as the KrokCart has
+      acknowledged writing it, and written again if it doesn't match.
+      When a download completes in this mode, a separate verify isn't
+      needed.  With a download window larger than one, sectors are read
+      back a window at a time.
+    */
+    void setVerifyWrites(bool enable) { myVerifyWrites = enable; }
+    bool getVerifyWrites() const      { return myVerifyWrites;   }
+
+    /**
+      Set whether a download that failed part way through is resumed,
+      skipping the sectors the journal says already reached this device
+      (only when the same image is being written to it again).  The
+      journal can't tell if a different KrokCart has been connected to
+      the device since, so this is off by default.
+    */
+    void setResume(bool enable) { myResume = enable; }
+
+    /**
+      The device (serial port) the cart is written to.  Progress in the
+      download journal is kept separately for each device.
+    */
+    void setDevice(const string& device) { myDevice = device; }
+
     /** Set number of write retries before bailing out. */
     void setRetry(int retry) { myRetry = retry; }
 
+    /** Get statistics for the transfer started by the last call to initSectors(). */
+    const TransferStats& stats() const { return myStats; }
+
+    /**
+      Set the number of sectors that may be sent to the KrokCart before
+      waiting for an acknowledgement.  A window of 1 is the traditional
+      stop-and-wait mode.
+    */
+    void setWindow(int window) { myWindow = std::max(window, 1); }
+
     /** Get the current cart size. */
     uInt32 getSize() const { return myCartSize; }
 
@@ -125,15 +199,29 @@ class Cart
     /** Get the most recent logged message. */
     const string& message() const { return myLogMessage; }
 
-    static void setLastRomFilePath(const string& rom) { ourLastCart = rom; }
+    /**
+      Set the file holding a digest of each sector on the KrokCart, as
+      left by the last download.  Incremental downloads only write the
+      sectors whose digest differs.
+    */
+    static void setManifestFilePath(const string& manifest) { ourManifest = manifest; }
 
-  private:
     /**
-      Read data from given file and place it in the given buffer.
+      Set the file recording the progress of downloads that didn't
+      complete; no journal is kept when this is empty.
+    */
+    static void setJournalFilePath(const string& journal) { ourJournal = journal; }
 
-      @return  The number of bytes read (0 indicates error).
+    /**
+      Forget which sectors were written to the cart on the given device,
+      since it has been unplugged (and another cart may take its place).
+      The next changed-only verify on that device is then a full one.
     */
-    uInt32 readFile(const string& filename, uInt8* buffer, uInt32 maxSize, bool showmessage = true) const;
+    static void forgetDevice(const string& device);
+
+  private:
+    // One flag for each sector of the KrokCart
+    using SectorSet = std::bitset<MAXCARTSIZE/256>;
 
     /**
       Write data from the given buffer to the given file.
@@ -145,17 +233,153 @@ class Cart
     /**
       Write the given sector to the serial port.
     */
-    void padImage(uInt8* buffer, uInt32 bufsize, uInt32 requiredsize) const;
+    void padImage(uInt8* buffer, uInt32 bufsize, uInt32 requiredsize,
+                  bool showmessage = true) const;
 
     /**
-      Write the given sector to the serial port.
+      The data to be written to the given sector of the KrokCart.  Sectors
+      not covered by the image are blank.
+    */
+    const uInt8* sectorData(uInt16 sector) const;
+
+    /**
+      Identifies the contents of the image, as written to the KrokCart.
+    */
+    string imageMD5() const;
+
+    /**
+      Calculate the XOR checksum of the given data, as used by the KrokCart.
+    */
+    static uInt8 checksum(const uInt8* data, uInt32 size);
+
+    /**
+      Build the framing (command header and checksum trailer) for the given
+      sector, so it can be sent along with the next batch.  The sector data
+      itself is sent straight from the cart image.
+    */
+    void stageSector(uInt16 sector);
+
+    /**
+      Write all staged sectors to the serial port in a single call, without
+      waiting for the KrokCart to acknowledge them.  If only part of the
+      batch is written, calling this again sends just the rest.
+    */
+    bool sendStagedSectors(SerialPort& port);
+
+    // The outcome of waiting for the KrokCart to reply to a command
+    enum Reply { ReplyOK, ReplyError, ReplyTimeout };
+
+    /**
+      Wait for the KrokCart to acknowledge the given (previously sent) sector.
+    */
+    Reply receiveSectorAck(uInt32 sector, SerialPort& port);
+
+    /**
+      Read and throw away anything the KrokCart sends, until it has been
+      quiet for as long as the given policy would wait for a reply.
+    */
+    static void drainReplies(SerialPort& port, const RetryPolicy& policy);
+
+    /**
+      Get back in step with the KrokCart after a sector read went wrong.
+      Whatever is left of the reply is thrown away, and then the single
+      ack byte the KrokCart waits for after a reply is sent.  The byte
+      doesn't start a command, so it's ignored by a KrokCart that never
+      replied.
+    */
+    void resyncRead(SerialPort& port);
+
+    /**
+      Stage the given sector and queue it for acknowledgement.  It isn't
+      actually sent until sendQueuedSectors() is called.
+    */
+    void queueSector(uInt16 sector);
+
+    /**
+      Send all sectors queued since the last call, retrying the send itself
+      up to the retry limit.  An exception is thrown on failure.
+    */
+    void sendQueuedSectors(SerialPort& port);
+
+    /**
+      Collect the acknowledgement for the oldest sector still in flight.
+      A sector that fails is re-sent and queued again, until the retry
+      limit is reached; then an exception is thrown.
+    */
+    void collectSectorAck(SerialPort& port);
+
+    /**
+      Read and verify the given sector from the serial port.  A sector
+      being read again ('resent') doesn't give a usable round-trip time.
+    */
+    bool verifySector(uInt32 sector, SerialPort& port, bool resent);
+
+    /**
+      Read back every sector acknowledged since the last call, writing
+      again (and reading back again) any that don't match, until the
+      retry limit is reached; then an exception is thrown.
     */
-    bool downloadSector(uInt32 sector, SerialPort& port) const;
+    void verifyWrittenSectors(SerialPort& port);
 
     /**
-      Read and verify the given sector from the serial port.
+      Note that the given sector is known to be on the KrokCart, and
+      update the journal every so often (in case we never get as far as
+      finalizeSectors()).
     */
-    bool verifySector(uInt32 sector, SerialPort& port) const;
+    void sectorDone(uInt16 sector);
+
+    /** Count the given sectors that are part of the current cart. */
+    uInt16 countSectors(const SectorSet& sectors) const;
+
+    /**
+      Digest of the given sector of the current image (never zero).
+    */
+    uInt64 sectorDigest(uInt16 sector) const;
+
+    /**
+      Fill in the digest of each sector from the manifest, with zero for
+      sectors that aren't known.
+      Must be called with ourLastCartMutex held.
+
+      @return  False if there is no (valid) manifest, else true
+    */
+    bool readManifest(uInt64* digests) const;
+
+    /**
+      Update the manifest with the sectors of the current image that
+      have reached the KrokCart.
+      Must be called with ourLastCartMutex held.
+    */
+    void updateManifest() const;
+
+    // Identifies a manifest file (and its version)
+    static constexpr char MANIFEST_MAGIC[8] = { 'K', 'C', 'M', 'F', 'S', 'T', '0', '1' };
+
+    /**
+      Look up the journal entry for this device, filling in which sectors
+      are already on the KrokCart if it is for the current image.
+      Must be called with ourLastCartMutex held.
+
+      @return  True if an entry for the current image was found
+    */
+    bool readJournal(SectorSet& done) const;
+
+    // Sectors completed between updates of the journal
+    static constexpr uInt32 JOURNAL_INTERVAL = 64;
+
+    // Most sectors acknowledged before the window is allowed to empty,
+    // so the acks can be confirmed
+    static constexpr uInt32 CONFIRM_INTERVAL = 64;
+
+    // Most ROMs read at the same time when creating a multicart
+    static constexpr int MULTIFILE_LOADERS = 32;
+
+    /**
+      Replace the journal entry for this device with the given sectors,
+      or remove it when 'done' is null.
+      Must be called with ourLastCartMutex held.
+    */
+    void writeJournal(const SectorSet* done) const;
 
     /**
       Fill the buffer with the data read ...
@@ -163,21 +387,82 @@ class Cart
     void menuEntry(uInt8* buffer, const string& name) const;
 
   private:
-    uInt8  myCart[MAXCARTSIZE];
+    // The image (padded to a whole number of sectors), and for 3F and 3E
+    // carts a copy of the upper bank, for the uppermost 2K of the KrokCart
+    ByteArray myImage;
+    ByteArray myHighBank;
     uInt32 myCartSize{0};
+
     uInt32 myRetry{0};
+    uInt32 myWindow{1};
     BSType myType{BS_NONE};
     bool   myIncremental{false};
+    bool   myVerifyChanged{false};
+    uInt32 myFullVerifyInterval{0};
+    bool   myVerifyWrites{false};
+    bool   myResume{false};
+    string myDevice;
 
     // The following keep track of progress of sector writes
     uInt16 myCurrentSector{0};
     uInt16 myNumSectors{0};
-    bool myModifiedSectors[MAXCARTSIZE/256];
+    uInt16 mySectorCount{0};
+    SectorSet myModifiedSectors;
+
+    // Sectors known to be on the KrokCart (including those written by an
+    // earlier, interrupted download), and the image they belong to
+    SectorSet mySectorsDone;
+    uInt32 myDoneSinceJournal{0};
+    bool myResumed{false};
+    string myImageMD5;
+
+    // Sectors sent to the KrokCart, but not yet acknowledged (oldest first)
+    std::deque<uInt16> myPendingSectors;
+
+    // Sectors acknowledged while others were still in flight (oldest
+    // first); acks don't say which sector they are for, so if an earlier
+    // one was lost, these were matched to the wrong sectors.  They are
+    // only trusted once every sector sent has been acknowledged.
+    std::deque<uInt16> myUnconfirmedSectors;
+
+    // Sectors acknowledged, but not yet read back (in verify writes mode)
+    std::deque<uInt16> myUnverifiedSectors;
+
+    // Framing for sectors queued but not yet sent
+    struct Frame {
+      uInt8 header[5];
+      uInt8 trailer;
+      uInt16 sector;
+    };
+    vector<Frame> myStagedFrames;
+    uInt32 myStagedSent{0};  // bytes of the staged frames already sent
+    vector<SerialPort::Segment> mySegments;
+    ByteArray mySectorRetries;
+    SectorSet mySectorResent;
+
+    // How long to wait for replies, learned from the link as it is used
+    RetryPolicy myWritePolicy;
+    RetryPolicy myReadPolicy;
+
+    // Statistics for the current download or verify
+    TransferStats myStats;
 
     bool myIsValid{false};
     string myLogMessage;
 
-    static string ourLastCart;
+    static string ourManifest;
+    static string ourJournal;
+    static std::mutex ourLastCartMutex;
+
+    // The sectors written by the last successful download to each device
+    // (a different cart may be on another one), and the digest of the
+    // image they belong to
+    struct LastWrite {
+      string md5;
+      SectorSet sectors;
+    };
+    static std::map<string, LastWrite> ourLastWritten;
+    static uInt32 ourChangedVerifies;
 };
 
 #endif
@@ -19,11 +19,11 @@
   @author  Stephen Anthony
 */
 
-#include <QFileInfo>
-#include <QSettings>
-
+#include <cctype>
+#include <cstdio>
 #include <cstring>
 
+#include "MappedFile.hxx"
 #include "MD5.hxx"
 #include "CartDetector.hxx"
 
@@ -32,23 +32,10 @@ BSType CartDetector::autodetectType(const string& rom)
 {
   BSType type = BS_NONE;
 
-  // Read file into buffer
-  std::ifstream in(rom, std::ios::binary);
-  if(in)
-  {
-    // Figure out how much data we should read
-    in.seekg(0, std::ios::end);
-    std::streampos length = in.tellg();
-    in.seekg(0, std::ios::beg);
-    if(length > 0)
-    {
-      uInt8* buffer = new uInt8[length];
-      in.read((char*)buffer, length);
-      in.close();
-      type = autodetectType(rom, buffer, length);
-      delete[] buffer;
-    }
-  }
+  // Detect directly from the file contents, without copying them
+  MappedFile image(rom);
+  if(!image.empty())
+    type = autodetectType(rom, image.data(), image.size());
   return type;
 }
 
@@ -56,7 +43,7 @@ BSType CartDetector::autodetectType(const string& rom)
 BSType CartDetector::autodetectType(const string& filename, const uInt8* image, uInt32 size)
 {
   // Is this ROM in the database?
-  BSType type = getRomInfo(filename, image, size);
+  BSType type = getRomInfo(image, size);
   if(type != BS_NONE)
     return type;
 
@@ -198,41 +185,135 @@ BSType CartDetector::autodetectType(const string& filename, const uInt8* image,
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void CartDetector::addRomInfo(const string& filename, BSType type,
-                              const uInt8* image, uInt32 size)
+void CartDetector::addRomInfo(BSType type, const uInt8* image, uInt32 size)
+{
+  addRomInfo(type, romDigest(image, size));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CartDetector::addRomInfo(BSType type, const string& md5)
+{
+  if(md5.size() != 32)
+    return false;
+
+  // Only the first half of the MD5 is used as the key (see romDigest())
+  uInt8 bytes[8];
+  for(uInt32 i = 0; i < sizeof(bytes); ++i)
+  {
+    size_t hi = string("0123456789abcdef").find(char(tolower(md5[2*i]))),
+           lo = string("0123456789abcdef").find(char(tolower(md5[2*i+1])));
+    if(hi == string::npos || lo == string::npos)
+      return false;
+    bytes[i] = uInt8(hi << 4 | lo);
+  }
+  uInt64 digest;
+  memcpy(&digest, bytes, sizeof(digest));
+  addRomInfo(type, digest);
+
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CartDetector::addRomInfo(BSType type, uInt64 digest)
+{
+  std::lock_guard<std::mutex> lock(ourRomInfoMutex);
+  loadRomInfo();
+  auto [it, added] = ourRomInfo.try_emplace(digest, type);
+  if(added || it->second != type)
+  {
+    it->second = type;
+    ourRomInfoChanged = true;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+BSType CartDetector::getRomInfo(const uInt8* image, uInt32 size)
+{
+  uInt64 digest = romDigest(image, size);
+
+  std::lock_guard<std::mutex> lock(ourRomInfoMutex);
+  loadRomInfo();
+  auto it = ourRomInfo.find(digest);
+
+  return it != ourRomInfo.end() ? it->second : BS_NONE;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CartDetector::saveRomInfo()
+{
+  std::lock_guard<std::mutex> lock(ourRomInfoMutex);
+  if(!ourRomInfoChanged)
+    return true;
+  else if(ourRomInfoFile == "")
+    return false;
+
+  // The file is a short header, followed by the digest and type of each
+  // ROM; write a new one and move it into place, so a reader never sees
+  // half a file
+  string temp = ourRomInfoFile + ".tmp";
+  {
+    std::ofstream out(temp, std::ios::binary);
+    out.write(ROMINFO_MAGIC, sizeof(ROMINFO_MAGIC));
+    for(const auto& [digest, type]: ourRomInfo)
+    {
+      uInt16 t = uInt16(type);
+      out.write(reinterpret_cast<const char*>(&digest), sizeof(digest));
+      out.write(reinterpret_cast<const char*>(&t), sizeof(t));
+    }
+    out.close();
+    if(!out)
+    {
+      std::remove(temp.c_str());
+      return false;
+    }
+  }
+  if(std::rename(temp.c_str(), ourRomInfoFile.c_str()) != 0)
+  {
+    std::remove(temp.c_str());
+    return false;
+  }
+  ourRomInfoChanged = false;
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CartDetector::setRomInfoFilePath(const string& file)
 {
-  // Add info in the form 'filename/md5' = type
-  QString file  = QFileInfo(QString(filename.c_str())).canonicalFilePath();
-  QString md5   = MD5(image, size).c_str();
-  QString key   = file + "/" + md5;
-  QString value = Bankswitch::typeToName(type).c_str();
-
-  QSettings s;
-  s.beginGroup("ROM Type");
-    s.remove(file);         // Remove all keys associated with this filename
-    s.setValue(key, value); // And add this new key
-  s.endGroup();
+  std::lock_guard<std::mutex> lock(ourRomInfoMutex);
+  ourRomInfoFile = file;
+  ourRomInfoLoaded = false;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-BSType CartDetector::getRomInfo(const string& filename,
-                                const uInt8* image, uInt32 size)
+void CartDetector::loadRomInfo()
 {
-  // Check if the type is already defined
-  // Remove any redundant entries
-  QString file  = QFileInfo(QString(filename.c_str())).canonicalFilePath();
-  QString md5   = MD5(image, size).c_str();
-  QString key   = file + "/" + md5;
-  QString value;
-
-  QSettings s;
-  s.beginGroup("ROM Type");
-    value = s.value(key, "").toString();
-    if(value == "")
-      s.remove(file);  // Try to keep the database clean
-  s.endGroup();
-
-  return Bankswitch::nameToType(value.toStdString());
+  if(ourRomInfoLoaded)
+    return;
+  ourRomInfoLoaded = true;
+
+  // Entries added before the file was known are kept
+  std::ifstream in(ourRomInfoFile, std::ios::binary);
+  char magic[sizeof(ROMINFO_MAGIC)];
+  if(!in.read(magic, sizeof(magic)) || memcmp(magic, ROMINFO_MAGIC, sizeof(magic)) != 0)
+    return;
+
+  uInt64 digest;
+  uInt16 type;
+  while(in.read(reinterpret_cast<char*>(&digest), sizeof(digest)) &&
+        in.read(reinterpret_cast<char*>(&type), sizeof(type)))
+    ourRomInfo.try_emplace(digest, BSType(type));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt64 CartDetector::romDigest(const uInt8* image, uInt32 size)
+{
+  // The first half of the MD5 is plenty to tell ROMs apart
+  uInt8 md5[16];
+  MD5(image, size, md5);
+
+  uInt64 digest;
+  memcpy(&digest, md5, sizeof(digest));
+  return digest;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -503,3 +584,10 @@ bool CartDetector::isProbablyX07(const uInt8* image, uInt32 size)
 
   return false;
 }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::unordered_map<uInt64, BSType> CartDetector::ourRomInfo;
+string CartDetector::ourRomInfoFile = "";
+bool CartDetector::ourRomInfoLoaded = false;
+bool CartDetector::ourRomInfoChanged = false;
+std::mutex CartDetector::ourRomInfoMutex;
@@ -15,6 +15,9 @@
 #ifndef CART_DETECTOR_HXX
 #define CART_DETECTOR_HXX
 
+#include <mutex>
+#include <unordered_map>
+
 #include "bspf.hxx"
 #include "BSType.hxx"
 
@@ -45,10 +48,61 @@ class CartDetector
     */
     static BSType autodetectType(const string& rom, const uInt8* image, uInt32 size);
 
-    static void addRomInfo(const string& filename, BSType type, const uInt8* image, uInt32 size);
-    static BSType getRomInfo(const string& filename, const uInt8* image, uInt32 size);
+    /**
+      Remember the bankswitching type of the given ROM image (for types
+      such as multicarts, which can't be detected).  ROMs are identified
+      by their contents, wherever the file happens to be.
+
+      The database is only written back by saveRomInfo(), so many ROMs
+      can be added at the cost of a single write.
+    */
+    static void addRomInfo(BSType type, const uInt8* image, uInt32 size);
+
+    /**
+      As above, for a ROM known only by the MD5 of its contents (as a
+      hex string).  Used to import entries kept by earlier versions.
+
+      @return  False if the MD5 isn't valid, else true
+    */
+    static bool addRomInfo(BSType type, const string& md5);
+
+    /**
+      Look up the bankswitching type of the given ROM image in the
+      database, returning BS_NONE if it isn't there.
+    */
+    static BSType getRomInfo(const uInt8* image, uInt32 size);
+
+    /**
+      Write the database back to its file, if anything was added since
+      it was last written.
+
+      @return  False if there was something to write and it couldn't be
+               written (no file set, or the write failed), else true
+    */
+    static bool saveRomInfo();
+
+    /**
+      Set the file the database is kept in; without one, entries only
+      last as long as the program.
+    */
+    static void setRomInfoFilePath(const string& file);
 
   private:
+    /**
+      Load the database from its file, the first time it is needed.
+      Must be called with ourRomInfoMutex held.
+    */
+    static void loadRomInfo();
+
+    /** Add (or update) the database entry with the given key. */
+    static void addRomInfo(BSType type, uInt64 digest);
+
+    /** The key for the given ROM image in the database. */
+    static uInt64 romDigest(const uInt8* image, uInt32 size);
+
+    // Identifies a database file (and its version)
+    static constexpr char ROMINFO_MAGIC[8] = { 'K', 'C', 'R', 'T', 'Y', 'P', '0', '1' };
+
     /**
       Search the image for the specified byte signature
 
@@ -133,6 +187,14 @@ class CartDetector
       Returns true if the image is probably an X07 bankswitching cartridge
     */
     static bool isProbablyX07(const uInt8* image, uInt32 size);
+
+  private:
+    // Bankswitching type of each ROM known to the database
+    static std::unordered_map<uInt64, BSType> ourRomInfo;
+    static string ourRomInfoFile;
+    static bool ourRomInfoLoaded;
+    static bool ourRomInfoChanged;
+    static std::mutex ourRomInfoMutex;
 };
 
 #endif
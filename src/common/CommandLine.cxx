@@ -0,0 +1,409 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+
+#include "Cart.hxx"
+#include "CommandLine.hxx"
+#include "KrokDaemon.hxx"
+#include "MultiFlash.hxx"
+#include "Version.hxx"
+
+static KrokDaemon* ourDaemon = nullptr;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static void handleSignal(int)
+{
+  if(ourDaemon)
+    ourDaemon->stop();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CommandLine::multiFlash(SerialPortManager& manager, const string& romfile,
+                             const string& bstype, int window, bool autoverify,
+                             bool verifyWrites, bool resume, bool stats)
+{
+  SerialPortManager::KrokCartList krokcarts = manager.findAllKrokCarts();
+  if(krokcarts.empty())
+  {
+    cout << "KrokCart not detected" << std::endl;
+    return false;
+  }
+  for(const auto& krokcart: krokcarts)
+    cout << "KrokCart: \'" << krokcart.versionID.c_str() << "\'"
+         << " @ \'" << krokcart.portName.c_str() << "\'"
+         << " (" << krokcart.baud << " baud)" << std::endl;
+
+  Cart cart;
+  cart.create(romfile, bstype);
+  cart.setWindow(window);
+  cart.setVerifyWrites(verifyWrites);
+  cart.setResume(resume);
+  if(!cart.isValid())
+  {
+    cout << "ERROR: Invalid cartridge, not written" << std::endl;
+    return false;
+  }
+
+  cout << std::endl << "Writing to " << krokcarts.size() << " KrokCarts ..." << std::endl;
+  auto start = std::chrono::steady_clock::now();
+
+  MultiFlash flash(cart, krokcarts, autoverify);
+  flash.start();
+
+  // Show the progress of each cart, once per second
+  while(!flash.finished())
+  {
+    manager.port().sleepMillis(1000);
+    for(const auto& target: flash.targets())
+    {
+      static constexpr char phase[] = { ' ', 'W', 'V', '-' };
+      uInt32 num = target->numSectors, percent = num ? 100 * target->sector / num : 0;
+      cout << " | " << phase[target->phase] << std::setw(4) << percent << "%";
+    }
+    cout << " |" << std::endl;
+  }
+  bool success = flash.wait();
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  cout << std::endl;
+  uInt32 bytes = 0;
+  for(const auto& target: flash.targets())
+  {
+    cout << target->krokcart.portName.c_str() << ": " << target->message.c_str() << std::endl;
+    if(target->success)
+      bytes += cart.getSize();
+  }
+  if(stats)
+    for(const auto& target: flash.targets())
+    {
+      cout << target->downloadStats.toJSON(target->krokcart.portName) << std::endl;
+      if(autoverify && target->verifyStats.sectors() > 0)
+        cout << target->verifyStats.toJSON(target->krokcart.portName) << std::endl;
+    }
+  cout << (success ? "All KrokCarts written" : "ERROR: Some KrokCarts failed")
+       << ", " << std::fixed << std::setprecision(1) << secs << " seconds ("
+       << int(bytes / 1024 / std::max(secs, 0.001)) << " KB/s total)" << std::endl;
+
+  return success;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CommandLine::run(SerialPortManager& manager, int ac, char* av[])
+{
+  string bstype = "", romfile = "", port = "";
+  bool incremental = false, autoverify = false, all = false, stats = false;
+  int window = 1;
+  uInt32 baud = 0, fullVerify = 0;
+  bool verifyChanged = false, verifyWrites = false, resume = false;
+
+  // Parse commandline args
+  for(int i = 1; i < ac; ++i)
+  {
+    if(strstr(av[i], "-bs=") == av[i])
+      bstype = av[i]+4;
+    else if(!strcmp(av[i], "-id"))
+      incremental = true;
+    else if(!strcmp(av[i], "-av"))
+      autoverify = true;
+    else if(!strcmp(av[i], "-all"))
+      all = true;
+    else if(!strcmp(av[i], "-stats"))
+      stats = true;
+    else if(!strcmp(av[i], "-vc"))
+      verifyChanged = true;
+    else if(!strcmp(av[i], "-vw"))
+      verifyWrites = true;
+    else if(!strcmp(av[i], "-resume"))
+      resume = true;
+    else if(strstr(av[i], "-fullverify=") == av[i])
+      fullVerify = BSPF::stoi(av[i]+12, 0);
+    else if(strstr(av[i], "-window=") == av[i])
+      window = BSPF::stoi(av[i]+8, 1);
+    else if(strstr(av[i], "-baud=") == av[i])
+      baud = BSPF::stoi(av[i]+6, 0);
+    else if(strstr(av[i], "-port=") == av[i])
+      port = av[i]+6;
+    else
+      romfile = av[i];
+  }
+
+  if(port != "" || baud > 0)
+    manager.setDefaultPort(port != "" ? port : manager.portName(), baud);
+  if(baud > 0)
+    manager.setBaudLadder(uIntArray{baud});
+  if(all)
+  {
+    // The manifest only describes one KrokCart, so each cart is written in
+    // full, and there's nothing for a changed-only verify to skip
+    if(incremental || verifyChanged)
+    {
+      cout << "ERROR: -id and -vc can't be used with -all" << std::endl;
+      return false;
+    }
+    return multiFlash(manager, romfile, bstype, window, autoverify, verifyWrites,
+                      resume, stats);
+  }
+
+  // When run by the daemon, the KrokCart may still be connected from the
+  // last request
+  if(!manager.krokCartAvailable() || port != "" || baud > 0)
+    manager.connectKrokCart();
+  if(manager.krokCartAvailable())
+  {
+    cout << "KrokCart: \'" << manager.versionID().c_str() << "\'"
+         << " @ \'" << manager.portName().c_str() << "\'"
+         << " (" << manager.baudRate() << " baud)" << std::endl;
+  }
+  else
+  {
+    cout << "KrokCart not detected" << std::endl;
+    return false;
+  }
+
+  // Create a new cart for writing
+  Cart cart;
+
+  // Create a new single-load cart
+  cart.create(romfile, bstype);
+  cart.setIncremental(incremental);
+  cart.setWindow(window);
+  cart.setVerifyChanged(verifyChanged, fullVerify);
+  cart.setVerifyWrites(verifyWrites);
+  cart.setResume(resume);
+  cart.setDevice(manager.portName());
+
+  // Write to serial port
+  bool success = false;
+  if(cart.isValid())
+  {
+    try
+    {
+      cout << std::endl;
+      uInt16 sector = 0, numSectors = cart.initSectors(true);
+      while(sector < numSectors)
+      {
+        uInt16 lower = cart.currentSector();
+        uInt16 upper = lower + std::min(15, int(numSectors-sector-1));
+
+        cout << "Sectors " << std::setw(4) << lower << " - " << std::setw(4) << upper << " | ";
+        for(uInt16 col = 0; col < 16; ++col)
+        {
+          if(sector < numSectors)
+          {
+            cart.writeNextSector(manager.port());
+            ++sector;
+            cout << "." << std::flush;
+          }
+          else
+            cout << " " << std::flush;
+        }
+        cout << " | successfully sent : " << std::setw(3) << (100*sector/numSectors) << "% complete" << std::endl;
+      }
+    }
+    catch(const char* msg)
+    {
+      cout << msg << std::endl;
+    }
+
+    if(stats)
+      cout << cart.stats().toJSON(manager.portName()) << std::endl;
+
+    if(cart.finalizeSectors())
+    {
+      cout << cart.message().c_str() << std::endl;
+      success = true;
+
+      // See if we should automatically verify the download
+      // (not needed when each sector was already read back as it was written)
+      if(autoverify && !verifyWrites)
+      {
+        // It seems we must wait a while before attempting a verify
+        manager.port().sleepMillis(100);
+        try
+        {
+          uInt16 sector = 0, numSectors = cart.initSectors(false);
+          while(sector < numSectors)
+          {
+            uInt16 lower = cart.currentSector();
+            uInt16 upper = lower + std::min(15, (int)(numSectors-sector-1));
+
+            cout << std::endl << "Sectors " << std::setw(4) << lower << " - " << std::setw(4) << upper << " | ";
+            for(uInt16 col = 0; col < 16; ++col)
+            {
+              if(sector < numSectors)
+              {
+                cart.verifyNextSector(manager.port());
+                ++sector;
+                cout << "." << std::flush;
+              }
+              else
+                cout << " " << std::flush;
+            }
+            cout << " | successfully verified : " << std::setw(3) << (100*sector/numSectors) << "% complete" << std::endl;
+          }
+        }
+        catch(const char* msg)
+        {
+          cout << msg << std::endl;
+          success = false;
+        }
+        if(stats)
+          cout << cart.stats().toJSON(manager.portName()) << std::endl;
+      }
+    }
+    else
+      cout << cart.message().c_str() << std::endl;
+  }
+  else
+    cout << "ERROR: Invalid cartridge, not written" << std::endl;
+
+  return success;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int CommandLine::daemon(SerialPortManager& manager, const string& socket)
+{
+
+  KrokDaemon daemon;
+  if(!daemon.open(socket))
+  {
+    cout << "ERROR: couldn't listen on '" << socket.c_str()
+         << "' (is another daemon running?)" << std::endl;
+    return 1;
+  }
+  ourDaemon = &daemon;
+  signal(SIGINT, handleSignal);
+  signal(SIGTERM, handleSignal);
+
+  // Connect now, and notice the KrokCart being unplugged between requests,
+  // so that the next request searches for it again
+  manager.startHotplugMonitor([](const string&, bool) { });
+  manager.connectKrokCart();
+  cout << "KrokCom daemon listening on '" << socket.c_str() << "'" << std::endl;
+
+  bool reconnect = false;
+  daemon.run([&](const StringList& args) {
+    // The last request connected with its own '-port=' or '-baud='
+    if(reconnect)
+    {
+      manager.connectKrokCart();
+      reconnect = false;
+    }
+
+    if(args.size() == 1 && args[0] == "-status")
+    {
+      if(manager.krokCartAvailable())
+        cout << "KrokCart: '" << manager.versionID().c_str() << "'"
+             << " @ '" << manager.portName().c_str() << "'"
+             << " (" << manager.baudRate() << " baud)" << std::endl;
+      else
+        cout << "KrokCart not connected" << std::endl;
+      return manager.krokCartAvailable() ? 0 : 1;
+    }
+    else if(args.size() == 1 && args[0] == "-shutdown")
+    {
+      cout << "KrokCom daemon stopping" << std::endl;
+      daemon.stop();
+      return 0;
+    }
+
+    // Anything else is run exactly as if given on the commandline
+    vector<char*> av = { const_cast<char*>("krokcom") };
+    for(const auto& arg: args)
+    {
+      av.push_back(const_cast<char*>(arg.c_str()));
+      if(arg.find("-port=") == 0 || arg.find("-baud=") == 0)
+        reconnect = true;
+    }
+
+    // '-port=' and '-baud=' only apply to the request that gives them;
+    // afterwards, go back to the KrokCart the daemon would find itself
+    string port = manager.portName();
+    uIntArray ladder = manager.baudLadder();
+    bool success = run(manager, int(av.size()), av.data());
+    if(reconnect)
+    {
+      manager.setBaudLadder(ladder);
+      manager.setDefaultPort(port);
+    }
+    return success ? 0 : 1;
+  });
+
+  manager.stopHotplugMonitor();
+  ourDaemon = nullptr;
+  return 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int CommandLine::remote(const string& socket, int ac, char* av[])
+{
+  // The daemon runs elsewhere, so files must be named in full
+  StringList args;
+  for(int i = 0; i < ac; ++i)
+  {
+    if(av[i][0] != '-' && std::filesystem::exists(av[i]))
+      args.push_back(std::filesystem::absolute(av[i]).string());
+    else
+      args.push_back(av[i]);
+  }
+
+  int status = KrokDaemon::request(socket, args);
+  if(status < 0)
+  {
+    cout << "ERROR: no KrokCom daemon listening on '" << socket.c_str() << "'" << std::endl;
+    return 1;
+  }
+  return status;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CommandLine::usage(const string& program, bool gui)
+{
+  cout << "Krokodile Commander for UNIX version " << KROK_VERSION << std::endl
+       << "  https://github.com/sa666666/krokcom" << std::endl
+       << std::endl
+       << "Usage: " << program.c_str() << " [options ...] datafile" << std::endl;
+  if(gui)
+    cout << "       Run without any options or datafile to use the graphical frontend" << std::endl;
+  cout << "       Consult the manual for more in-depth information" << std::endl
+       << std::endl
+       << "Valid options are:" << std::endl
+       << std::endl
+       << "  -bs=[type]  Specify the bankswitching scheme for a ROM image (default is 'auto')" << std::endl
+       << "  -av         Automatically verify after a download is successfully completed" << std::endl
+       << "  -vc         Only verify the sectors written by the last download" << std::endl
+       << "  -fullverify=[n] With -vc, verify all sectors every n'th time anyway" << std::endl
+       << "  -vw         Read back each sector as it is written, rewriting any that don't match" << std::endl
+       << "  -id         Perform an incremental download (only download changes since last time)" << std::endl
+       << "  -resume     Skip the sectors that reached the KrokCart if the last download of this ROM failed" << std::endl
+       << "              (only if the same KrokCart is still connected to that port)" << std::endl
+       << "  -all        Write to every KrokCart connected to the system at the same time" << std::endl
+       << "              (each one in full, so not with -id or -vc)" << std::endl
+       << "  -stats      Print statistics for each transfer, as one JSON object per line" << std::endl
+       << "  -window=[n] Send up to n sectors before waiting for an acknowledgement (default is 1)" << std::endl
+       << "  -baud=[n]   Only connect at the given baud rate (default is the fastest that works)" << std::endl
+       << "  -port=[dev] Look for a KrokCart on the given device first (eg. one made by krokemu)" << std::endl
+       << "  -daemon[=socket] Stay running, keeping the KrokCart connected, and take requests" << std::endl
+       << "              from '-remote' (default socket is '$HOME/.KCDAEMON.sock')" << std::endl
+       << "  -remote[=socket] Pass the remaining options to a running daemon; also accepts" << std::endl
+       << "              '-status' and '-shutdown'" << std::endl
+       << "  -help       Displays the message you're now reading" << std::endl
+       << std::endl
+       << "This software is Copyright (c) 2009-2025 Stephen Anthony, and is released" << std::endl
+       << "under the GNU GPL version 3." << std::endl
+       << std::endl;
+}
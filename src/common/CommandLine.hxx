@@ -0,0 +1,73 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef COMMAND_LINE_HXX
+#define COMMAND_LINE_HXX
+
+#include "bspf.hxx"
+#include "SerialPortManager.hxx"
+
+/**
+  Everything krokcom can do without its window: writing a ROM to one
+  KrokCart or to all of them, running as a daemon, and sending requests
+  to a daemon.  None of this needs Qt, so it is shared by the GUI
+  program and the headless one.
+
+  @author  Stephen Anthony
+*/
+class CommandLine
+{
+  public:
+    /**
+      Print the valid options.  The graphical frontend is only mentioned
+      when 'gui' is set.
+    */
+    static void usage(const string& program, bool gui);
+
+    /**
+      Act on the given commandline, writing (and optionally verifying)
+      a ROM.  The KrokCart is only searched for when one isn't already
+      connected.
+
+      @return  True if the ROM was written (and verified, if requested)
+    */
+    static bool run(SerialPortManager& manager, int ac, char* av[]);
+
+    /**
+      Keep the KrokCart connected, and run requests arriving on the
+      given socket until told to stop.
+
+      @return  The exit status for the program
+    */
+    static int daemon(SerialPortManager& manager, const string& socket);
+
+    /**
+      Pass the given commandline to the daemon listening on the given
+      socket.
+
+      @return  The exit status of the request
+    */
+    static int remote(const string& socket, int ac, char* av[]);
+
+  private:
+    /** Write the ROM to every KrokCart attached to the system at once. */
+    static bool multiFlash(SerialPortManager& manager, const string& romfile,
+                           const string& bstype, int window, bool autoverify,
+                           bool verifyWrites, bool resume, bool stats);
+
+  private:
+    CommandLine() = delete;
+};
+
+#endif // COMMAND_LINE_HXX
@@ -0,0 +1,101 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#if defined(__linux__)
+  #include <sys/inotify.h>
+  #include <poll.h>
+  #include <unistd.h>
+#endif
+
+#include "HotplugMonitor.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+HotplugMonitor::~HotplugMonitor()
+{
+  stop();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool HotplugMonitor::start(const Callback& callback)
+{
+#if defined(__linux__)
+  stop();
+
+  myHandle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if(myHandle < 0)
+    return false;
+  if(inotify_add_watch(myHandle, "/dev", IN_CREATE | IN_DELETE) < 0)
+  {
+    close(myHandle);
+    myHandle = -1;
+    return false;
+  }
+
+  myCallback = callback;
+  myRunning = true;
+  myThread = std::thread(&HotplugMonitor::run, this);
+  return true;
+#else
+  return false;
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void HotplugMonitor::stop()
+{
+  myRunning = false;
+  if(myThread.joinable())
+    myThread.join();
+
+#if defined(__linux__)
+  if(myHandle >= 0)
+  {
+    close(myHandle);
+    myHandle = -1;
+  }
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void HotplugMonitor::run()
+{
+#if defined(__linux__)
+  alignas(struct inotify_event) char buffer[4096];
+
+  while(myRunning)
+  {
+    // Wake up regularly to check whether we've been asked to stop
+    struct pollfd pfd;
+    pfd.fd = myHandle;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if(poll(&pfd, 1, 250) <= 0)
+      continue;
+
+    ssize_t len = read(myHandle, buffer, sizeof(buffer));
+    for(ssize_t i = 0; i < len; )
+    {
+      const struct inotify_event* event = (const struct inotify_event*)(buffer + i);
+      i += sizeof(struct inotify_event) + event->len;
+      if(event->len == 0)
+        continue;
+
+      // Only USB serial adapters come and go
+      const char* ptr = event->name;
+      if((strstr(ptr, "ttyUSB") == ptr) || (strstr(ptr, "ttyACM") == ptr))
+        myCallback(string("/dev/") + ptr, (event->mask & IN_CREATE) != 0);
+    }
+  }
+#endif
+}
@@ -0,0 +1,66 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef HOTPLUG_MONITOR_HXX
+#define HOTPLUG_MONITOR_HXX
+
+#include <atomic>
+#include <thread>
+
+#include "bspf.hxx"
+
+/**
+  This class watches for USB serial devices being plugged in or removed,
+  and reports each change through a callback.  The callback is run from
+  the monitor's own thread.
+
+  Currently this is only implemented for Linux (using inotify on '/dev');
+  on other systems start() simply fails, and devices must be searched
+  for manually.
+
+  @author  Stephen Anthony
+*/
+class HotplugMonitor
+{
+  public:
+    using Callback = std::function<void(const string& device, bool added)>;
+
+    HotplugMonitor() = default;
+    ~HotplugMonitor();
+
+    /**
+      Start watching for devices.
+
+      @param callback  Called with the device name whenever one appears
+                       (added is true) or disappears (added is false)
+      @return  False if hotplug monitoring isn't available, else true
+    */
+    bool start(const Callback& callback);
+
+    /**
+      Stop watching for devices; the callback won't be called after this.
+    */
+    void stop();
+
+  private:
+    void run();
+
+  private:
+    Callback myCallback;
+    std::thread myThread;
+    std::atomic<bool> myRunning{false};
+    int myHandle{-1};
+};
+
+#endif // HOTPLUG_MONITOR_HXX
@@ -19,6 +19,7 @@
 #include <QStatusBar>
 #include <QTextEdit>
 #include <QProgressDialog>
+#include <QTimer>
 #include <QAction>
 #include <QActionGroup>
 #include <QButtonGroup>
@@ -54,6 +55,12 @@ KrokComWindow::KrokComWindow(QWidget* parent)
   // We use a thread so the UI isn't blocked
   myFindKrokThread = new FindKrokThread(myManager);
 
+  // Downloads and verifies are also done in a thread, for the same reason
+  myTransferThread = new TransferThread(myManager);
+
+  // As is looking through a folder for multicart ROMs
+  myRomScanThread = new RomScanThread();
+
   // Set up signal/slot connections
   setupConnections();
 
@@ -62,6 +69,10 @@ KrokComWindow::KrokComWindow(QWidget* parent)
   myStatus->setAlignment(Qt::AlignHCenter|Qt::AlignVCenter);
   statusBar()->addPermanentWidget(myStatus, 1000);
 
+  // The statistics for the last transfer (details are in the tooltip)
+  myStats = new QLabel();
+  statusBar()->addPermanentWidget(myStats);
+
   // The LED part of the status bar
   myLED = new QLabel();
   statusBar()->addPermanentWidget(myLED);
@@ -93,22 +104,46 @@ KrokComWindow::KrokComWindow(QWidget* parent)
   // By default, start looking for ROMs in the users' home directory
   myLastDir.setPath(QDir::home().absolutePath());
 
-  // Store last ROM info in '$HOME/.KCLASTROM.bin'
-  QString lastrom = QDir(QDir::home().absolutePath() + "/.KCLASTROM.bin").absolutePath();
-  Cart::setLastRomFilePath(lastrom.toStdString());
+  // Store the digests of the last ROM written in '$HOME/.KCMANIFEST.bin'
+  QString manifest = QDir(QDir::home().absolutePath() + "/.KCMANIFEST.bin").absolutePath();
+  Cart::setManifestFilePath(manifest.toStdString());
+
+  // Progress of interrupted downloads goes in '$HOME/.KCJOURNAL.txt'
+  QString journal = QDir(QDir::home().absolutePath() + "/.KCJOURNAL.txt").absolutePath();
+  Cart::setJournalFilePath(journal.toStdString());
+
+  // ROMs whose type can't be detected (ie, multicarts) in '$HOME/.KCROMTYPES.bin'
+  QString romtypes = QDir(QDir::home().absolutePath() + "/.KCROMTYPES.bin").absolutePath();
+  CartDetector::setRomInfoFilePath(romtypes.toStdString());
+  importRomTypes();
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 KrokComWindow::~KrokComWindow()
 {
+  // The monitor thread calls back into this object, so stop it first
+  myManager.stopHotplugMonitor();
+
   if(myFindKrokThread)
   {
     myFindKrokThread->quit();
     delete myFindKrokThread;
   }
+  delete myTransferThread;  // cancels and waits for any transfer in progress
+  delete myRomScanThread;   // likewise for a folder scan
   delete ui;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::startHotplugMonitor()
+{
+  // Hotplug events arrive on the monitor thread; pass them on to the UI
+  myManager.startHotplugMonitor([this](const string& device, bool added) {
+    QMetaObject::invokeMethod(this, "slotHotplug", Qt::QueuedConnection,
+        Q_ARG(QString, QString(device.c_str())), Q_ARG(bool, added));
+  });
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void KrokComWindow::setupConnections()
 {
@@ -123,6 +158,8 @@ void KrokComWindow::setupConnections()
 
   // Options menu
   connect(ui->actIncDownload, SIGNAL(triggered(bool)), this, SLOT(slotEnableIncDownload(bool)));
+  connect(ui->actVerifyWrites, SIGNAL(triggered(bool)), this, SLOT(slotEnableVerifyWrites(bool)));
+  connect(ui->actResumeDownload, SIGNAL(triggered(bool)), this, SLOT(slotEnableResume(bool)));
   QActionGroup* group = new QActionGroup(this);
   group->setExclusive(true);
   group->addAction(ui->actRetry0);
@@ -130,6 +167,19 @@ void KrokComWindow::setupConnections()
   group->addAction(ui->actRetry2);
   group->addAction(ui->actRetry3);
   connect(group, SIGNAL(triggered(QAction*)), this, SLOT(slotRetry(QAction*)));
+  group = new QActionGroup(this);
+  group->setExclusive(true);
+  group->addAction(ui->actWindow1);
+  group->addAction(ui->actWindow2);
+  group->addAction(ui->actWindow4);
+  group->addAction(ui->actWindow8);
+  connect(group, SIGNAL(triggered(QAction*)), this, SLOT(slotWindow(QAction*)));
+  group = new QActionGroup(this);
+  group->setExclusive(true);
+  group->addAction(ui->actVerifyAll);
+  group->addAction(ui->actVerifyChanged);
+  group->addAction(ui->actVerifyChangedFull);
+  connect(group, SIGNAL(triggered(QAction*)), this, SLOT(slotVerifyMode(QAction*)));
 
   // Help menu
   connect(ui->actAbout, SIGNAL(triggered()), this, SLOT(slotAbout()));
@@ -137,6 +187,17 @@ void KrokComWindow::setupConnections()
 
   // Other
   connect(myFindKrokThread, SIGNAL(finished()), this, SLOT(slotUpdateFindKrokStatus()));
+  connect(myTransferThread, SIGNAL(jobStarted(int,int)), this, SLOT(slotTransferStarted(int,int)));
+  connect(myTransferThread, SIGNAL(jobProgress(int)), this, SLOT(slotTransferProgress(int)));
+  connect(myTransferThread, SIGNAL(jobFinished(int,bool,const QString&)),
+          this, SLOT(slotTransferFinished(int,bool,const QString&)));
+  connect(myTransferThread, SIGNAL(jobStats(const QString&,const QString&)),
+          this, SLOT(slotTransferStats(const QString&,const QString&)));
+  connect(myRomScanThread, SIGNAL(scanStarted(int)), this, SLOT(slotMCScanStarted(int)));
+  connect(myRomScanThread, SIGNAL(romFound(int,const QString&,const QString&)),
+          this, SLOT(slotMCRomFound(int,const QString&,const QString&)));
+  connect(myRomScanThread, SIGNAL(scanProgress(int)), this, SLOT(slotMCScanProgress(int)));
+  connect(myRomScanThread, SIGNAL(scanFinished(int,bool)), this, SLOT(slotMCScanFinished(int,bool)));
 
   ///////////////////////////////////////////////////////////
   // 'ROM' tab
@@ -190,18 +251,39 @@ void KrokComWindow::readSettings()
   QSettings s;
 
   s.beginGroup("MainWindow");
-    myManager.setDefaultPort(s.value("krokport", "").toString().toStdString());
+    myManager.setDefaultPort(s.value("krokport", "").toString().toStdString(),
+                             s.value("krokbaud", 0).toUInt());
     int retrycount = s.value("retrycount", 0).toInt();
     if(retrycount == 0)       ui->actRetry0->setChecked(true);
     else if(retrycount == 1)  ui->actRetry1->setChecked(true);
     else if(retrycount == 2)  ui->actRetry2->setChecked(true);
     else if(retrycount == 3)  ui->actRetry3->setChecked(true);
     myCart.setRetry(retrycount);
+    int window = s.value("window", 1).toInt();
+    if(window == 8)       ui->actWindow8->setChecked(true);
+    else if(window == 4)  ui->actWindow4->setChecked(true);
+    else if(window == 2)  ui->actWindow2->setChecked(true);
+    else { window = 1;    ui->actWindow1->setChecked(true); }
+    myCart.setWindow(window);
+    int verifymode = s.value("verifymode", 0).toInt();
+    if(verifymode == 2)       ui->actVerifyChangedFull->setChecked(true);
+    else if(verifymode == 1)  ui->actVerifyChanged->setChecked(true);
+    else                      ui->actVerifyAll->setChecked(true);
+    slotVerifyMode(verifymode == 2 ? ui->actVerifyChangedFull :
+                   verifymode == 1 ? ui->actVerifyChanged : ui->actVerifyAll);
     bool incremental = s.value("incremental", false).toBool();
     ui->actIncDownload->setChecked(incremental);
     myCart.setIncremental(incremental);
+    // Resuming trusts that the KrokCart wasn't swapped after the failed
+    // download, so it is off unless asked for
+    bool resume = s.value("resume", false).toBool();
+    ui->actResumeDownload->setChecked(resume);
+    myCart.setResume(resume);
     ui->actAutoDownFileSelect->setChecked(s.value("autodownload", false).toBool());
     ui->actAutoVerifyDownload->setChecked(s.value("autoverify", false).toBool());
+    bool verifywrites = s.value("verifywrites", false).toBool();
+    ui->actVerifyWrites->setChecked(verifywrites);
+    myCart.setVerifyWrites(verifywrites);
     ui->mcartTVType->setCurrentIndex(s.value("tvtype", 0).toInt());
   s.endGroup();
 
@@ -225,6 +307,28 @@ void KrokComWindow::readSettings()
   s.endGroup();
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::importRomTypes()
+{
+  // Earlier versions kept the ROM type database in the settings, as
+  // 'ROM Type/<file>/<md5>' = type; move any such entries into the
+  // database file, then remove them, so this is only done once
+  QSettings s;
+  s.beginGroup("ROM Type");
+    const QStringList keys = s.allKeys();
+    for(const auto& key: keys)
+    {
+      BSType type = Bankswitch::nameToType(s.value(key).toString().toStdString());
+      if(type != BS_NONE && type != BS_AUTO)
+        CartDetector::addRomInfo(type, key.section('/', -1).toStdString());
+    }
+  s.endGroup();
+
+  // Only forget the old entries once they're safely in the database
+  if(!keys.isEmpty() && CartDetector::saveRomInfo())
+    s.remove("ROM Type");
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void KrokComWindow::closeEvent(QCloseEvent* event)
 {
@@ -234,21 +338,45 @@ void KrokComWindow::closeEvent(QCloseEvent* event)
     event->ignore();
     return;
   }
+  // A transfer can be stopped at the next sector, so do that instead
+  if(myTransferThread->busy())
+  {
+    myTransferThread->cancel();
+    myTransferThread->wait();
+  }
+  if(myRomScanThread->isRunning())
+  {
+    myRomScanThread->cancel();
+    myRomScanThread->wait();
+  }
 
   // Save settings
   QSettings s;
 
   s.beginGroup("MainWindow");
     s.setValue("krokport", QString(myManager.portName().c_str()));
+    if(myManager.krokCartAvailable())
+      s.setValue("krokbaud", myManager.baudRate());
     int retrycount = 0;
     if(ui->actRetry0->isChecked())       retrycount = 0;
     else if(ui->actRetry1->isChecked())  retrycount = 1;
     else if(ui->actRetry2->isChecked())  retrycount = 2;
     else if(ui->actRetry3->isChecked())  retrycount = 3;
     s.setValue("retrycount", retrycount);
+    int window = 1;
+    if(ui->actWindow2->isChecked())       window = 2;
+    else if(ui->actWindow4->isChecked())  window = 4;
+    else if(ui->actWindow8->isChecked())  window = 8;
+    s.setValue("window", window);
+    int verifymode = 0;
+    if(ui->actVerifyChanged->isChecked())           verifymode = 1;
+    else if(ui->actVerifyChangedFull->isChecked())  verifymode = 2;
+    s.setValue("verifymode", verifymode);
     s.setValue("autodownload", ui->actAutoDownFileSelect->isChecked());
     s.setValue("autoverify", ui->actAutoVerifyDownload->isChecked());
+    s.setValue("verifywrites", ui->actVerifyWrites->isChecked());
     s.setValue("incremental", ui->actIncDownload->isChecked());
+    s.setValue("resume", ui->actResumeDownload->isChecked());
     s.setValue("tvtype", ui->mcartTVType->currentIndex());
   s.endGroup();
 
@@ -293,6 +421,13 @@ bool KrokComWindow::eventFilter(QObject* object, QEvent* event)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void KrokComWindow::slotConnectKrokCart()
 {
+  // The port can't be searched while it's being used for a transfer
+  if(myTransferThread->busy())
+  {
+    statusMessage("Can't search for Krokodile Cart during a transfer.");
+    return;
+  }
+
   myStatus->setText("Searching for Krokodile Cart.");
   myLED->setPixmap(QPixmap(":icons/pics/ledoff.png"));
 
@@ -309,7 +444,7 @@ void KrokComWindow::slotUpdateFindKrokStatus()
     myKrokCartMessage.append(myManager.versionID().c_str());
     myKrokCartMessage.append("\' @ \'");
     myKrokCartMessage.append(myManager.portName().c_str());
-    myKrokCartMessage.append("\'.");
+    myKrokCartMessage.append("\' (" + QString::number(myManager.baudRate()) + " baud).");
     myLED->setPixmap(QPixmap(":icons/pics/ledon.png"));
   }
   else
@@ -320,6 +455,29 @@ void KrokComWindow::slotUpdateFindKrokStatus()
   myStatus->setText(myKrokCartMessage);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotHotplug(const QString& device, bool added)
+{
+  if(myFindKrokThread->isRunning())
+    return;
+
+  if(!added)
+  {
+    // The manager has already marked the cart as gone, if it was ours
+    if(!myManager.krokCartAvailable() && device == QString(myManager.portName().c_str()))
+    {
+      myKrokCartMessage = "Krokodile Cart disconnected.";
+      myLED->setPixmap(QPixmap(":icons/pics/ledoff.png"));
+      myStatus->setText(myKrokCartMessage);
+    }
+  }
+  else if(!myManager.krokCartAvailable() && !myTransferThread->busy())
+  {
+    // Give the system a moment to set up the new device (permissions, etc)
+    QTimer::singleShot(500, this, SLOT(slotConnectKrokCart()));
+  }
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void KrokComWindow::slotOpenROM()
 {
@@ -339,116 +497,105 @@ void KrokComWindow::slotOpenROM()
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void KrokComWindow::slotDownloadROM()
 {
-  if(myDownloadInProgress)
-    return;
-
   ui->verifyButton->setDisabled(true);  ui->actVerifyROM->setDisabled(true);
 
   if(!myManager.krokCartAvailable())
   {
-    myDownloadInProgress = false;
     myStatus->setText("Krokodile Cart not found.");
     return;
   }
   else if(!myCart.isValid())
   {
-    myDownloadInProgress = false;
     statusMessage("Invalid cartridge.");
     return;
   }
 
   // Switch to 'ROM' tab
   ui->tabWidget->setCurrentIndex(0);
-  myDownloadInProgress = true;
-
-  // Write to serial port
-  uInt16 sector = 0, numSectors = myCart.initSectors(true);
-  QProgressDialog progress("Downloading ROM...", QString(), 0, numSectors, this);
-  progress.setWindowIcon(QPixmap(":icons/pics/appicon.png"));
-  progress.setWindowModality(Qt::WindowModal);
-  progress.setMinimumDuration(0);
-  progress.setValue(0);
-  try
-  {
-    for(sector = 0; sector < numSectors; ++sector)
-    {
-      myCart.writeNextSector(myManager.port());
-      progress.setValue(sector);
-    }
-  }
-  catch(const char* msg)
-  {
-    cout << msg << std::endl;
-  }
-  myDownloadInProgress = false;
-
-  progress.setValue(numSectors);
-  if(myCart.finalizeSectors())
-  {
-    statusMessage(QString(myCart.message().c_str()));
-
-    ui->verifyButton->setDisabled(false);  ui->actVerifyROM->setDisabled(false);
 
-    // See if we should automatically verify the download
-    if(ui->actAutoVerifyDownload->isChecked())
-      slotVerifyROM();
-  }
-  else
-    statusMessage(QString(myCart.message().c_str()));
+  // The transfer thread gets its own copy of the cart, so it will run
+  // after any transfer already in progress (and any automatic verify
+  // checks this same copy)
+  myTransferThread->queueJob(TransferThread::Download, myCart,
+                             ui->actAutoVerifyDownload->isChecked());
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void KrokComWindow::slotVerifyROM()
 {
-  if(myDownloadInProgress)
-    return;
-
   if(!myManager.krokCartAvailable())
   {
-    myDownloadInProgress = false;
     myStatus->setText("Krokodile Cart not found.");
     return;
   }
   else if(!myCart.isValid())
   {
-    myDownloadInProgress = false;
     statusMessage("Invalid cartridge.");
     return;
   }
 
   // Switch to 'ROM' tab
   ui->tabWidget->setCurrentIndex(0);
-  myDownloadInProgress = true;
 
   // Verify data previously written to serial port
-  uInt16 sector = 0, numSectors = myCart.initSectors(false);
-  QProgressDialog progress("Verifying ROM...", QString(), 0, numSectors, this);
-  progress.setWindowIcon(QPixmap(":icons/pics/appicon.png"));
-  progress.setWindowModality(Qt::WindowModal);
-  progress.setMinimumDuration(0);
-  progress.setValue(0);
-  try
-  {
-    for(sector = 0; sector < numSectors; ++sector)
-    {
-      myCart.verifyNextSector(myManager.port());
-      progress.setValue(sector);
-    }
-  }
-  catch(const char* msg)
+  myTransferThread->queueJob(TransferThread::Verify, myCart);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotTransferStarted(int type, int numSectors)
+{
+  if(!myTransferDialog)
   {
-    cout << msg << std::endl;
+    myTransferDialog = new QProgressDialog(this);
+    myTransferDialog->setWindowIcon(QPixmap(":icons/pics/appicon.png"));
+    myTransferDialog->setWindowModality(Qt::NonModal);
+    myTransferDialog->setMinimumDuration(0);
+    myTransferDialog->setAutoClose(false);
+    myTransferDialog->setAutoReset(false);
+    connect(myTransferDialog, SIGNAL(canceled()), this, SLOT(slotCancelTransfer()));
   }
+  myTransferDialog->reset();
+  myTransferDialog->setLabelText(type == TransferThread::Download ?
+                                 "Downloading ROM..." : "Verifying ROM...");
+  myTransferDialog->setRange(0, numSectors);
+  myTransferDialog->setValue(0);
+  myTransferDialog->show();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotTransferProgress(int sectors)
+{
+  if(myTransferDialog)
+    myTransferDialog->setValue(sectors);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotTransferFinished(int type, bool success, const QString& message)
+{
+  statusMessage(message);
+  if(myTransferDialog)
+    myTransferDialog->hide();
 
-  if(sector == numSectors)
+  // An automatic verify (if wanted) has already been queued by the thread
+  if(type == TransferThread::Download && success)
   {
-    progress.setValue(numSectors);
-    statusMessage("Verified download of " + QString::number(sector) + " sectors.");
+    ui->verifyButton->setDisabled(false);  ui->actVerifyROM->setDisabled(false);
   }
-  else
-    statusMessage("Verify failure on sector " + QString::number(sector) + ".");
+}
 
-  myDownloadInProgress = false;
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotTransferStats(const QString& summary, const QString& details)
+{
+  myStats->setText(summary);
+  myStats->setToolTip(details);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotCancelTransfer()
+{
+  myTransferThread->cancel();
+  if(myTransferDialog)
+    myTransferDialog->hide();
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -458,6 +605,20 @@ void KrokComWindow::slotEnableIncDownload(bool enable)
   myCart.setIncremental(enable);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotEnableResume(bool enable)
+{
+  ui->actResumeDownload->setChecked(enable);
+  myCart.setResume(enable);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotEnableVerifyWrites(bool enable)
+{
+  ui->actVerifyWrites->setChecked(enable);
+  myCart.setVerifyWrites(enable);
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void KrokComWindow::slotRetry(QAction* action)
 {
@@ -467,6 +628,23 @@ void KrokComWindow::slotRetry(QAction* action)
   else if(action == ui->actRetry3)  myCart.setRetry(3);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotWindow(QAction* action)
+{
+  if(action == ui->actWindow1)       myCart.setWindow(1);
+  else if(action == ui->actWindow2)  myCart.setWindow(2);
+  else if(action == ui->actWindow4)  myCart.setWindow(4);
+  else if(action == ui->actWindow8)  myCart.setWindow(8);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotVerifyMode(QAction* action)
+{
+  if(action == ui->actVerifyAll)               myCart.setVerifyChanged(false);
+  else if(action == ui->actVerifyChanged)      myCart.setVerifyChanged(true);
+  else if(action == ui->actVerifyChangedFull)  myCart.setVerifyChanged(true, 10);
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void KrokComWindow::slotSetBSType(const QString& text)
 {
@@ -968,16 +1146,63 @@ void KrokComWindow::slotMCAddFromDir()
   if(path.isNull())
     return;
 
-  QStringList menuNames, fileNames;
-  int count = getRomsFromFolder(path, menuNames, fileNames, bstype, ui->mcartTable->rowCount());
+  // ROMs are added to the list as the scan finds them
+  myRomScanThread->scan(path, bstype, ui->mcartTable->rowCount());
+}
 
-  // Add ROMs to list
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotMCScanStarted(int numFiles)
+{
+  // Anything still arriving from a previous (cancelled) scan has been
+  // received by now
   clearMCContents(ui->mcartTable->rowCount());
-  for(int i = 0; i < count; ++i)
-    setMCTableEntry(i, menuNames.at(i), fileNames.at(i));
 
-  statusMessage("Added " + QString::number(count) + " \'" +
-                QString(Bankswitch::typeToName(bstype).c_str()) + "\' roms.");
+  if(!myScanDialog)
+  {
+    myScanDialog = new QProgressDialog(this);
+    myScanDialog->setWindowIcon(QPixmap(":icons/pics/appicon.png"));
+    myScanDialog->setWindowModality(Qt::NonModal);
+    myScanDialog->setMinimumDuration(500);  // Small folders are done by then
+    myScanDialog->setAutoClose(false);
+    myScanDialog->setAutoReset(false);
+    myScanDialog->setLabelText("Looking for ROMs...");
+    connect(myScanDialog, SIGNAL(canceled()), this, SLOT(slotCancelMCScan()));
+  }
+  myScanDialog->reset();
+  myScanDialog->setRange(0, numFiles);
+  myScanDialog->setValue(0);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotMCRomFound(int entry, const QString& menuName, const QString& fileName)
+{
+  setMCTableEntry(entry, menuName, fileName);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotMCScanProgress(int filesChecked)
+{
+  if(myScanDialog)
+    myScanDialog->setValue(filesChecked);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotMCScanFinished(int numRoms, bool cancelled)
+{
+  if(myScanDialog)
+    myScanDialog->hide();
+
+  statusMessage("Added " + QString::number(numRoms) + " \'" +
+                QString(Bankswitch::typeToName(myRomScanThread->type()).c_str()) +
+                "\' roms" + (cancelled ? " (cancelled)." : "."));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokComWindow::slotCancelMCScan()
+{
+  myRomScanThread->cancel();
+  if(myScanDialog)
+    myScanDialog->hide();
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -1044,29 +1269,6 @@ void KrokComWindow::clearMCContents(int rows)
   ui->mcartTable->setRowCount(rows);
 }
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-int KrokComWindow::getRomsFromFolder(QString folder, QStringList& menuNames,
-                                     QStringList& fileNames, BSType type,
-                                     int maxEntries)
-{
-  QDir dir(folder, "*.a26 *.bin *.rom", QDir::Name|QDir::IgnoreCase, QDir::Files);
-  QFileInfoList files = dir.entryInfoList();
-
-  int i = 0;
-  while(i < files.size() && fileNames.size() < maxEntries)
-  {
-    BSType detected = CartDetector::autodetectType(files.at(i).absoluteFilePath().toStdString());
-    // Valid ROM, add to list
-    if(detected == type || detected == BS_4K)
-    {
-      fileNames.push_back(files.at(i).absoluteFilePath());
-      menuNames.push_back(files.at(i).completeBaseName().toUpper().left(13));
-    }
-    ++i;
-  }
-  return fileNames.size();
-}
-
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void KrokComWindow::slotCreateMulticart()
 {
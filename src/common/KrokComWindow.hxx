@@ -19,11 +19,14 @@
 #include <QAction>
 #include <QLabel>
 #include <QProgressBar>
+#include <QProgressDialog>
 #include <QDir>
 
 #include "Cart.hxx"
 #include "SerialPortManager.hxx"
 #include "FindKrokThread.hxx"
+#include "TransferThread.hxx"
+#include "RomScanThread.hxx"
 #include "ui_krokcomwindow.h"
 
 namespace Ui
@@ -41,6 +44,7 @@ Q_OBJECT
   public:
     SerialPortManager& portManager() { return myManager; }
     void connectKrokCart() { slotConnectKrokCart(); }
+    void startHotplugMonitor();
 
   protected:
     void closeEvent(QCloseEvent* event);
@@ -49,6 +53,7 @@ Q_OBJECT
   private:
     void setupConnections();
     void readSettings();
+    void importRomTypes();
     void loadROM(const QString& file, bool showmessage = true);
     void assignToQPButton(QPushButton* button, int id);
     void assignToQPButton(QPushButton* button, int id, const QString& file, bool save);
@@ -57,20 +62,28 @@ Q_OBJECT
     void setMCTableEntry(int row, const QString& menuName, const QString& fileName);
     void getMCTableEntry(int row, QString& menuName, QString& fileName) const;
     void clearMCContents(int rows);
-    static int getRomsFromFolder(QString folder, QStringList& menuNames, QStringList& fileNames,
-                                 BSType type, int maxEntries);
 
     void statusMessage(const QString& msg);
 
   private slots:
     void slotConnectKrokCart();
     void slotUpdateFindKrokStatus();
+    void slotHotplug(const QString& device, bool added);
 
     void slotOpenROM();
     void slotDownloadROM();
     void slotVerifyROM();
+    void slotTransferStarted(int type, int numSectors);
+    void slotTransferProgress(int sectors);
+    void slotTransferFinished(int type, bool success, const QString& message);
+    void slotTransferStats(const QString& summary, const QString& details);
+    void slotCancelTransfer();
     void slotEnableIncDownload(bool);
+    void slotEnableResume(bool);
+    void slotEnableVerifyWrites(bool);
     void slotRetry(QAction*);
+    void slotWindow(QAction*);
+    void slotVerifyMode(QAction*);
     void slotSetBSType(const QString&);
     void slotAbout();
     void slotQPButtonClicked(QAbstractButton* b);
@@ -87,12 +100,21 @@ Q_OBJECT
     void slotMCMoveUp();
     void slotMCMoveDown();
     void slotMCAddFromDir();
+    void slotMCScanStarted(int numFiles);
+    void slotMCRomFound(int entry, const QString& menuName, const QString& fileName);
+    void slotMCScanProgress(int filesChecked);
+    void slotMCScanFinished(int numRoms, bool cancelled);
+    void slotCancelMCScan();
 
     void slotCreateMulticart();
 
   private:
     Ui::KrokComWindow* ui{nullptr};
     FindKrokThread* myFindKrokThread{nullptr};
+    TransferThread* myTransferThread{nullptr};
+    QProgressDialog* myTransferDialog{nullptr};
+    RomScanThread* myRomScanThread{nullptr};
+    QProgressDialog* myScanDialog{nullptr};
     QButtonGroup* myQPGroup{nullptr};
 
     Cart myCart;
@@ -101,11 +123,11 @@ Q_OBJECT
 
     QLabel* myStatus{nullptr};
     QLabel* myLED{nullptr};
+    QLabel* myStats{nullptr};
     QProgressBar* myProgress{nullptr};
     QDir myLastDir;
 
     QString myKrokCartMessage;
-    bool myDownloadInProgress{false};
 };
 
 #endif
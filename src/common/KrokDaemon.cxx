@@ -0,0 +1,302 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <mutex>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "KrokDaemon.hxx"
+
+/**
+  Sends everything written to it over a socket.  If the client goes
+  away part way through a request, the rest of the output is dropped;
+  the request itself still runs to completion.
+
+  A request may write to cout from several threads at once (eg. one
+  per KrokCart with '-all'), so the buffer is kept to itself rather
+  than handed to the stream; every write then comes through here,
+  under the lock.
+*/
+class SocketBuffer : public std::streambuf
+{
+  public:
+    explicit SocketBuffer(int fd) : myFd(fd) { }
+    ~SocketBuffer() override { flush(); }
+
+  protected:
+    int overflow(int c) override
+    {
+      if(c != traits_type::eof())
+      {
+        char ch = char(c);
+        xsputn(&ch, 1);
+      }
+      return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override
+    {
+      std::lock_guard<std::mutex> lock(myMutex);
+      myBuffer.append(s, size_t(n));
+      if(myBuffer.size() >= 1024)
+        send();
+      return n;
+    }
+    int sync() override { flush(); return 0; }
+
+  private:
+    void flush()
+    {
+      std::lock_guard<std::mutex> lock(myMutex);
+      send();
+    }
+
+    void send()
+    {
+      const char* data = myBuffer.data();
+      size_t size = myBuffer.size();
+      while(size > 0 && myFd >= 0)
+      {
+        ssize_t sent = ::send(myFd, data, size, 0);
+        if(sent > 0)
+        {
+          data += sent;
+          size -= sent;
+        }
+        else if(sent < 0 && errno != EINTR)
+          myFd = -1;  // Client has gone away
+      }
+      myBuffer.clear();
+    }
+
+  private:
+    int myFd{-1};
+    string myBuffer;
+    std::mutex myMutex;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+KrokDaemon::~KrokDaemon()
+{
+  if(myListen >= 0)
+  {
+    close(myListen);
+    unlink(myPath.c_str());
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string KrokDaemon::defaultSocketPath()
+{
+  const char* home = getenv("HOME");
+  return string(home ? home : ".") + "/.KCDAEMON.sock";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool KrokDaemon::open(const string& path)
+{
+  sockaddr_un addr{};
+  if(path.size() >= sizeof(addr.sun_path))
+    return false;
+
+  // Only one daemon can own the socket; if nobody answers, the socket
+  // file is stale
+  int other = connectTo(path);
+  if(other >= 0)
+  {
+    close(other);
+    return false;
+  }
+  unlink(path.c_str());
+
+  myListen = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(myListen < 0)
+    return false;
+
+  // Only the owner may send requests; the socket is created that way,
+  // so there is no moment when anyone else could connect
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  mode_t mask = umask(S_IRWXG | S_IRWXO);
+  int bound = bind(myListen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  umask(mask);
+  if(bound != 0 || listen(myListen, 8) != 0)
+  {
+    close(myListen);
+    myListen = -1;
+    return false;
+  }
+  myPath = path;
+
+  // A client going away mid-request must not take the daemon with it
+  signal(SIGPIPE, SIG_IGN);
+
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokDaemon::run(const Handler& handler)
+{
+  myRunning = true;
+  while(myRunning)
+  {
+    // Wake up now and then, to notice being stopped
+    pollfd pfd = { myListen, POLLIN, 0 };
+    if(poll(&pfd, 1, 250) <= 0)
+      continue;
+
+    int client = accept(myListen, nullptr, nullptr);
+    if(client >= 0)
+    {
+      serve(client, handler);
+      close(client);
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokDaemon::serve(int client, const Handler& handler)
+{
+  // Arguments arrive one per line, ending with an empty line; a client
+  // that doesn't send a complete request in time (or sends far more
+  // than any commandline could need) is dropped
+  string data;
+  while(data != "\n" && data.find("\n\n") == string::npos)
+  {
+    pollfd pfd = { client, POLLIN, 0 };
+    char buffer[1024];
+    ssize_t received = 0;
+    if(poll(&pfd, 1, 5000) <= 0 ||
+       (received = recv(client, buffer, sizeof(buffer), 0)) <= 0 ||
+       data.size() + received > MAX_REQUEST_SIZE)
+      return;
+    data.append(buffer, received);
+  }
+
+  StringList args;
+  istringstream lines(data);
+  string line;
+  while(std::getline(lines, line) && line != "")
+    args.push_back(line);
+
+  cout << "Request:";
+  for(const auto& arg: args)
+    cout << " " << arg.c_str();
+  cout << std::endl;
+
+  // Whatever the request prints goes back to the client
+  int status = 1;
+  SocketBuffer output(client);
+  std::streambuf* console = cout.rdbuf(&output);
+  try
+  {
+    status = handler(args);
+  }
+  catch(const char* msg)
+  {
+    cout << msg << std::endl;
+  }
+  cout << std::flush;
+  cout.rdbuf(console);
+  cout.clear();
+
+  // End of output, then the exit status
+  uInt8 trailer[2] = { 0, uInt8(status) };
+  send(client, trailer, sizeof(trailer), 0);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int KrokDaemon::request(const string& path, const StringList& args)
+{
+  int fd = connectTo(path);
+  if(fd < 0)
+    return -1;
+
+  string request;
+  for(const auto& arg: args)
+    request += arg + "\n";
+  request += "\n";
+
+  const char* data = request.c_str();
+  size_t size = request.size();
+  while(size > 0)
+  {
+    ssize_t sent = send(fd, data, size, 0);
+    if(sent < 0 && errno == EINTR)
+      continue;
+    else if(sent <= 0)
+      break;
+    data += sent;
+    size -= sent;
+  }
+
+  // Copy output until the end marker; the exit status follows it
+  // (a daemon that dies mid-request counts as a failure)
+  int status = 1;
+  bool ended = false;
+  char buffer[1024];
+  ssize_t received;
+  while((received = recv(fd, buffer, sizeof(buffer), 0)) != 0)
+  {
+    if(received < 0)
+    {
+      if(errno == EINTR)
+        continue;
+      break;
+    }
+    ssize_t i = 0;
+    if(!ended)
+    {
+      while(i < received && buffer[i] != 0)
+        ++i;
+      cout.write(buffer, i);
+      cout << std::flush;
+      if(i == received)
+        continue;
+      ended = true;
+      ++i;
+    }
+    if(i < received)
+    {
+      status = uInt8(buffer[i]);
+      break;
+    }
+  }
+  close(fd);
+
+  return status;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int KrokDaemon::connectTo(const string& path)
+{
+  sockaddr_un addr{};
+  if(path.size() >= sizeof(addr.sun_path))
+    return -1;
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+  {
+    close(fd);
+    fd = -1;
+  }
+  return fd;
+}
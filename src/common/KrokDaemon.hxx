@@ -0,0 +1,94 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef KROK_DAEMON_HXX
+#define KROK_DAEMON_HXX
+
+#include <atomic>
+#include <functional>
+
+#include "bspf.hxx"
+
+/**
+  This class lets a long-running krokcom process take requests from
+  other (short-lived) ones, over a local Unix-domain socket.  The
+  daemon keeps the KrokCart connected between requests, so a request
+  pays neither for starting Qt nor for searching the serial ports.
+
+  A request is simply a list of commandline arguments, sent one per
+  line and ending with an empty line.  Everything the daemon writes to
+  cout while running the request is passed back to the client as it is
+  produced, followed by a NUL byte and the request's exit status.
+
+  Requests are run one at a time, in the order they arrive.
+
+  @author  Stephen Anthony
+*/
+class KrokDaemon
+{
+  public:
+    // Runs a single request, returning its exit status
+    using Handler = std::function<int(const StringList& args)>;
+
+  public:
+    KrokDaemon() = default;
+    ~KrokDaemon();
+
+    /** The socket used when none is given ('$HOME/.KCDAEMON.sock'). */
+    static string defaultSocketPath();
+
+    /**
+      Start listening on the given socket.  A socket left behind by a
+      daemon that has since exited is replaced.
+
+      @return  False if another daemon is using the socket, or it
+               couldn't be created, else true
+    */
+    bool open(const string& path);
+
+    /** Serve requests until stop() is called. */
+    void run(const Handler& handler);
+
+    /**
+      Make run() return once the current request (if any) is finished.
+      This is safe to call from a signal handler.
+    */
+    void stop() { myRunning = false; }
+
+    /**
+      Send a request to the daemon listening on the given socket, copying
+      its output to cout as it arrives.
+
+      @return  The exit status of the request, or -1 if no daemon is
+               listening on the socket
+    */
+    static int request(const string& path, const StringList& args);
+
+  private:
+    // The largest request accepted from a client, in bytes
+    static constexpr size_t MAX_REQUEST_SIZE = 64 * 1024;
+
+    /** Connect to the given socket, returning the descriptor (or -1). */
+    static int connectTo(const string& path);
+
+    /** Read a request from the client, run it, and send back the results. */
+    void serve(int client, const Handler& handler);
+
+  private:
+    int myListen{-1};
+    string myPath;
+    std::atomic<bool> myRunning{false};
+};
+
+#endif // KROK_DAEMON_HXX
@@ -321,12 +321,8 @@ static void MD5_memset(POINTER output, int value, unsigned int len)
 string MD5(const uInt8* buffer, uInt32 length)
 {
   char hex[] = "0123456789abcdef";
-  MD5_CTX context;
   unsigned char md5[16];
-
-  MD5Init(&context);
-  MD5Update(&context, buffer, length);
-  MD5Final(md5, &context);
+  MD5(buffer, length, md5);
 
   string result;
   for(int t = 0; t < 16; ++t)
@@ -337,3 +333,13 @@ string MD5(const uInt8* buffer, uInt32 length)
 
   return result;
 }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void MD5(const uInt8* buffer, uInt32 length, uInt8 digest[16])
+{
+  MD5_CTX context;
+
+  MD5Init(&context);
+  MD5Update(&context, buffer, length);
+  MD5Final(digest, &context);
+}
@@ -27,4 +27,13 @@
 */
 string MD5(const uInt8* buffer, uInt32 length);
 
+/**
+  As above, but the digest is returned as its 16 raw bytes.
+
+  @param buffer The message to compute the digest of
+  @param length The length of the message
+  @param digest Filled in with the message-digest
+*/
+void MD5(const uInt8* buffer, uInt32 length, uInt8 digest[16]);
+
 #endif
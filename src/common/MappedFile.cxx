@@ -0,0 +1,80 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Cart.hxx"
+#include "MappedFile.hxx"
+
+// Files that must be read into a buffer are read this far, at most
+static constexpr size_t MAX_READ_SIZE = MAXCARTSIZE + 1;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+MappedFile::MappedFile(const string& filename)
+{
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0)
+    return;
+
+  struct stat st;
+  if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+  {
+    // Nothing we load comes anywhere near 4GB, so just refuse such files
+    if(st.st_size == 0 || uInt64(st.st_size) > 0xffffffff)
+    {
+      close(fd);
+      return;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map != MAP_FAILED)
+    {
+      myData = static_cast<const uInt8*>(map);
+      mySize = uInt32(st.st_size);
+      myMapped = true;
+      madvise(map, mySize, MADV_SEQUENTIAL);
+      close(fd);
+      return;
+    }
+  }
+
+  // Not a regular file, or mapping isn't possible (some network filesystems);
+  // fall back to reading it, but only as far as needed to tell that it's
+  // too big for a KrokCart
+  uInt8 chunk[16_KB];
+  ssize_t n;
+  while(myBuffer.size() < MAX_READ_SIZE &&
+        ((n = read(fd, chunk, std::min<size_t>(sizeof(chunk),
+                   MAX_READ_SIZE - myBuffer.size()))) > 0 || (n < 0 && errno == EINTR)))
+    if(n > 0)
+      myBuffer.insert(myBuffer.end(), chunk, chunk + n);
+  close(fd);
+
+  if(!myBuffer.empty())
+  {
+    myData = myBuffer.data();
+    mySize = uInt32(myBuffer.size());
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+MappedFile::~MappedFile()
+{
+  if(myMapped)
+    munmap(const_cast<uInt8*>(myData), mySize);
+}
@@ -0,0 +1,58 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef MAPPED_FILE_HXX
+#define MAPPED_FILE_HXX
+
+#include "bspf.hxx"
+
+/**
+  A read-only view of the contents of a ROM file.  Regular files are
+  memory-mapped, so the image is read in place (and only the pages
+  actually touched are ever read from disk); anything that can't be
+  mapped is read into a buffer instead.
+
+  A file that doesn't exist or can't be read gives an empty view, as
+  does one of 4GB or more.  When a file has to be read into a buffer,
+  it is read only to one byte past the largest cart image; that is
+  still enough to see that it is too large.
+
+  @author  Stephen Anthony
+*/
+class MappedFile
+{
+  public:
+    explicit MappedFile(const string& filename);
+    ~MappedFile();
+
+    /** The contents of the file (nullptr when it is empty). */
+    const uInt8* data() const { return myData; }
+
+    /** The size of the file, in bytes. */
+    uInt32 size() const { return mySize; }
+
+    bool empty() const { return mySize == 0; }
+
+  private:
+    const uInt8* myData{nullptr};
+    uInt32 mySize{0};
+    bool myMapped{false};
+    ByteArray myBuffer;
+
+  private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+#endif // MAPPED_FILE_HXX
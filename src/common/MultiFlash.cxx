@@ -0,0 +1,163 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include "MultiFlash.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+MultiFlash::MultiFlash(const Cart& cart,
+                       const SerialPortManager::KrokCartList& krokcarts,
+                       bool autoverify)
+  : myAutoVerify(autoverify)
+{
+  for(const auto& krokcart: krokcarts)
+  {
+    auto target = std::make_unique<Target>();
+    target->krokcart = krokcart;
+    target->cart = std::make_unique<Cart>(cart);
+    target->cart->setIncremental(false);
+    target->cart->setDevice(krokcart.portName);
+    myTargets.push_back(std::move(target));
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+MultiFlash::~MultiFlash()
+{
+  cancel();
+  wait();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void MultiFlash::start()
+{
+  myCancelled = false;
+  for(auto& target: myTargets)
+    myThreads.emplace_back([this, &target]() { run(*target); });
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool MultiFlash::wait()
+{
+  for(auto& t: myThreads)
+    t.join();
+  myThreads.clear();
+
+  bool success = !myTargets.empty();
+  for(const auto& target: myTargets)
+    success = success && target->success;
+
+  return success;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool MultiFlash::finished() const
+{
+  for(const auto& target: myTargets)
+    if(target->phase != Done)
+      return false;
+
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void MultiFlash::run(Target& target)
+{
+  SerialPortType port;
+  port.setBaud(target.krokcart.baud);
+  port.setControlSwap(false);
+
+  if(port.openPort(target.krokcart.portName))
+  {
+    download(target, port);
+    if(target.success && myAutoVerify && !target.cart->getVerifyWrites() && !myCancelled)
+    {
+      // It seems we must wait a while before attempting a verify
+      port.sleepMillis(100);
+      verify(target, port);
+    }
+    port.closePort();
+  }
+  else
+    target.message = "Couldn't open port.";
+
+  target.phase = Done;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void MultiFlash::download(Target& target, SerialPort& port)
+{
+  Cart& cart = *target.cart;
+  uInt16 sector = 0, numSectors = cart.initSectors(true);
+  target.sector = 0;
+  target.numSectors = numSectors;
+  target.phase = Downloading;
+
+  try
+  {
+    for(sector = 0; sector < numSectors && !myCancelled; ++sector)
+    {
+      cart.writeNextSector(port);
+      target.sector = sector + 1;
+    }
+
+    // Sectors already in flight must still be acknowledged
+    if(myCancelled)
+      cart.flushSectors(port);
+  }
+  catch(const char* msg)
+  {
+    target.message = msg;
+  }
+
+  target.downloadStats = cart.stats();
+  target.success = cart.finalizeSectors();
+  if(target.success || target.message == "")
+    target.message = cart.message();
+  if(!target.success && myCancelled)
+    target.message = "Download cancelled after " + std::to_string(sector) + " sectors.";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void MultiFlash::verify(Target& target, SerialPort& port)
+{
+  Cart& cart = *target.cart;
+  uInt16 sector = 0, numSectors = cart.initSectors(false);
+  target.sector = 0;
+  target.numSectors = numSectors;
+  target.phase = Verifying;
+
+  string error;
+  try
+  {
+    for(sector = 0; sector < numSectors && !myCancelled; ++sector)
+    {
+      cart.verifyNextSector(port);
+      target.sector = sector + 1;
+    }
+  }
+  catch(const char* msg)
+  {
+    error = msg;
+  }
+
+  target.verifyStats = cart.stats();
+  target.success = sector == numSectors;
+  if(target.success)
+    target.message = "Verified download of " + std::to_string(cart.stats().sectors()) + " sectors.";
+  else if(myCancelled)
+    target.message = "Verify cancelled after " + std::to_string(sector) + " sectors.";
+  else
+    target.message = "Verify failure on sector " + std::to_string(sector) +
+                     (error != "" ? " (" + error + ")." : ".");
+}
@@ -0,0 +1,101 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef MULTI_FLASH_HXX
+#define MULTI_FLASH_HXX
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "bspf.hxx"
+#include "Cart.hxx"
+#include "SerialPortManager.hxx"
+
+/**
+  This class writes (and optionally verifies) one ROM image to several
+  KrokCarts at once.  Each cart gets its own thread, serial port and
+  copy of the image, so the carts progress (and retry) independently,
+  and a slow or failing cart doesn't hold up the others.
+
+  @author  Stephen Anthony
+*/
+class MultiFlash
+{
+  public:
+    enum Phase { Waiting, Downloading, Verifying, Done };
+
+    // The state of the transfer to a single KrokCart
+    struct Target {
+      SerialPortManager::KrokCart krokcart;
+      std::unique_ptr<Cart> cart;
+
+      std::atomic<Phase> phase{Waiting};
+      std::atomic<uInt16> sector{0};
+      std::atomic<uInt16> numSectors{0};
+
+      // Only valid once the phase is 'Done'
+      bool success{false};
+      string message;
+      TransferStats downloadStats;
+      TransferStats verifyStats;
+    };
+
+    /**
+      Prepare to write the given ROM image to each of the given KrokCarts.
+      Incremental download is turned off, since there's no way to know
+      what each cart held before.
+    */
+    MultiFlash(const Cart& cart, const SerialPortManager::KrokCartList& krokcarts,
+               bool autoverify);
+    ~MultiFlash();
+
+    /**
+      Start all transfers, each in its own thread.
+    */
+    void start();
+
+    /**
+      Wait for all transfers to finish.
+
+      @return  True if every cart was written (and verified) successfully
+    */
+    bool wait();
+
+    /**
+      Ask all transfers to stop at the next sector.
+    */
+    void cancel() { myCancelled = true; }
+
+    /**
+      Have all transfers finished (successfully or not)?
+    */
+    bool finished() const;
+
+    /** Access the individual transfers, to report their progress. */
+    const vector<std::unique_ptr<Target>>& targets() const { return myTargets; }
+
+  private:
+    void run(Target& target);
+    void download(Target& target, SerialPort& port);
+    void verify(Target& target, SerialPort& port);
+
+  private:
+    vector<std::unique_ptr<Target>> myTargets;
+    vector<std::thread> myThreads;
+    bool myAutoVerify{false};
+    std::atomic<bool> myCancelled{false};
+};
+
+#endif // MULTI_FLASH_HXX
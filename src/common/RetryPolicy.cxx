@@ -0,0 +1,72 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <cmath>
+
+#include "RetryPolicy.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void RetryPolicy::sample(uInt32 usec)
+{
+  // Gains as recommended by RFC 6298 (alpha = 1/8, beta = 1/4)
+  if(!myHaveSample)
+  {
+    mySRTT = usec;
+    myRTTVAR = usec / 2.0;
+    myHaveSample = true;
+  }
+  else
+  {
+    myRTTVAR = 0.75 * myRTTVAR + 0.25 * std::abs(mySRTT - usec);
+    mySRTT   = 0.875 * mySRTT + 0.125 * usec;
+  }
+  replied();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void RetryPolicy::replied()
+{
+  myBackoff = 1;
+  myConsecutiveTimeouts = 0;
+  mySilentTime = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void RetryPolicy::timedOut()
+{
+  ++myConsecutiveTimeouts;
+  mySilentTime += timeout();
+  if(myBackoff < MAX_REPLY_TIMEOUT / MIN_REPLY_TIMEOUT)
+    myBackoff *= 2;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 RetryPolicy::timeout() const
+{
+  return BSPF::clamp<uInt32>(quietTime() * myBackoff, MIN_REPLY_TIMEOUT, MAX_REPLY_TIMEOUT);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 RetryPolicy::quietTime() const
+{
+  if(!myHaveSample)
+    return INIT_REPLY_TIMEOUT;
+
+  // RFC 6298's SRTT + max(G, 4 * RTTVAR), rounded up; on a steady link
+  // RTTVAR all but vanishes, so G also grows with the round-trip time
+  double margin = std::max(REPLY_TIMEOUT_GRANULARITY * 1000.0 + mySRTT / 4,
+                           4 * myRTTVAR);
+  uInt32 base = uInt32(std::ceil((mySRTT + margin) / 1000.0));
+  return BSPF::clamp<uInt32>(base, MIN_REPLY_TIMEOUT, MAX_REPLY_TIMEOUT);
+}
@@ -0,0 +1,109 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef RETRY_POLICY_HXX
+#define RETRY_POLICY_HXX
+
+#include "bspf.hxx"
+
+// Limits (in milliseconds) on the time to wait for a reply from the KrokCart
+#define MIN_REPLY_TIMEOUT  50
+#define MAX_REPLY_TIMEOUT  2000
+#define INIT_REPLY_TIMEOUT 500
+
+// Least margin (in milliseconds) allowed over the round-trip time, for
+// USB scheduling and flash programming, which vary more than the link
+#define REPLY_TIMEOUT_GRANULARITY 5
+
+// Number of timeouts in a row, and the least time (in milliseconds) spent
+// waiting over them, after which the KrokCart is assumed gone
+#define MAX_CONSECUTIVE_TIMEOUTS 3
+#define MIN_DEAD_TIME 1000
+
+/**
+  This class decides how long to wait for the KrokCart to reply to a
+  command, in the same way as TCP computes its retransmission timeout
+  (RFC 6298).  The round-trip time of the link is estimated from replies
+  to commands that were sent only once (Karn's algorithm), and the timeout
+  is set to allow for the observed variation, or for the clock granularity
+  G and a quarter of the round-trip time, whichever is more.  Each timeout
+  doubles the wait for the next reply, and a valid reply resets it.
+
+  After several timeouts in a row (with no valid reply in between), spanning
+  at least a second, the link is considered dead, so a transfer can give up
+  early rather than working through its retries for every remaining sector.
+
+  @author  Stephen Anthony
+*/
+class RetryPolicy
+{
+  public:
+    RetryPolicy() = default;
+
+    /**
+      Forget everything learned about the link.
+    */
+    void reset() { *this = RetryPolicy(); }
+
+    /**
+      Record a valid reply to a command that was only sent once.
+
+      @param usec  The round-trip time of the command, in microseconds
+    */
+    void sample(uInt32 usec);
+
+    /**
+      Record a valid reply to a command that was sent more than once.  Its
+      round-trip time is ambiguous, so it is not used as a sample.
+    */
+    void replied();
+
+    /**
+      Record a command whose reply didn't arrive in time.
+    */
+    void timedOut();
+
+    /**
+      The time to wait for the next reply, in milliseconds.
+    */
+    uInt32 timeout() const;
+
+    /**
+      The time after which a reply can be considered lost, in milliseconds.
+      This is the timeout without any backoff applied.
+    */
+    uInt32 quietTime() const;
+
+    /**
+      Has the link stopped responding altogether?
+    */
+    bool dead() const
+    {
+      return myConsecutiveTimeouts >= MAX_CONSECUTIVE_TIMEOUTS &&
+             mySilentTime >= MIN_DEAD_TIME;
+    }
+
+    /** The current smoothed round-trip time estimate, in microseconds. */
+    double roundTrip() const { return mySRTT; }
+
+  private:
+    bool   myHaveSample{false};
+    double mySRTT{0};     // smoothed round-trip time (usec)
+    double myRTTVAR{0};   // round-trip time variation (usec)
+    uInt32 myBackoff{1};  // multiplier applied after timeouts
+    uInt32 myConsecutiveTimeouts{0};
+    uInt32 mySilentTime{0};  // time waited over those timeouts (msec)
+};
+
+#endif // RETRY_POLICY_HXX
@@ -0,0 +1,113 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <QDir>
+#include <QFileInfoList>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "CartDetector.hxx"
+#include "RomScanThread.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+RomScanThread::RomScanThread()
+  : QThread()
+{
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+RomScanThread::~RomScanThread()
+{
+  cancel();
+  wait();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void RomScanThread::scan(const QString& folder, BSType type, int maxEntries)
+{
+  cancel();
+  wait();
+
+  myFolder = folder;
+  myType = type;
+  myMaxEntries = maxEntries;
+  myCancelled = false;
+  start();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void RomScanThread::run()
+{
+  QDir dir(myFolder, "*.a26 *.bin *.rom", QDir::Name|QDir::IgnoreCase, QDir::Files);
+  QFileInfoList files = dir.entryInfoList();
+  const int numFiles = files.size();
+  emit scanStarted(numFiles);
+
+  StringList paths;
+  for(const auto& file: files)
+    paths.push_back(file.absoluteFilePath().toStdString());
+
+  // Each detector takes the next file nobody has started on yet
+  vector<BSType> detected(numFiles, BS_NONE);
+  vector<bool> checked(numFiles, false);
+  std::mutex mutex;
+  std::condition_variable checkedCond;
+  std::atomic<int> nextFile{0};
+  std::atomic<bool> enough{false};
+  auto detect = [&]()
+  {
+    for(int i = nextFile++; i < numFiles && !enough && !myCancelled; i = nextFile++)
+    {
+      BSType type = CartDetector::autodetectType(paths[i]);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      detected[i] = type;
+      checked[i] = true;
+      checkedCond.notify_one();
+    }
+  };
+  int numDetectors = std::min<int>(numFiles,
+                     std::max(4u, std::thread::hardware_concurrency()));
+  vector<std::thread> detectors;
+  for(int t = 0; t < numDetectors; ++t)
+    detectors.emplace_back(detect);
+
+  // Pass on the results in folder order, as they become available
+  int numRoms = 0;
+  for(int i = 0; i < numFiles && numRoms < myMaxEntries; ++i)
+  {
+    {
+      // Cancelling doesn't wake us up, so check for it every so often
+      std::unique_lock<std::mutex> lock(mutex);
+      while(!checked[i] && !myCancelled)
+        checkedCond.wait_for(lock, std::chrono::milliseconds(50));
+      if(!checked[i])
+        break;
+    }
+    if(detected[i] == myType || detected[i] == BS_4K)
+      emit romFound(numRoms++, files.at(i).completeBaseName().toUpper().left(13),
+                    files.at(i).absoluteFilePath());
+    emit scanProgress(i + 1);
+  }
+
+  // Files already being checked are finished, but nothing new is started
+  enough = true;
+  for(auto& detector: detectors)
+    detector.join();
+
+  emit scanFinished(numRoms, myCancelled);
+}
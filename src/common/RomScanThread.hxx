@@ -0,0 +1,74 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef ROM_SCAN_THREAD_HXX
+#define ROM_SCAN_THREAD_HXX
+
+#include <QString>
+#include <QThread>
+
+#include <atomic>
+
+#include "BSType.hxx"
+
+/**
+  This class looks through a folder for ROMs that can go in a multicart,
+  in a separate thread, in the same way as FindKrokThread does for port
+  searching.  Bankswitch detection is spread over several more threads,
+  since a large ROM library can take a long time to go through.
+
+  ROMs are reported as they are found, but always in folder order, so
+  the ROMs picked are the same as a simple one-at-a-time scan would
+  pick.  The scan stops as soon as enough ROMs are found, or when it
+  is cancelled.
+
+  @author  Stephen Anthony
+*/
+class RomScanThread: public QThread
+{
+Q_OBJECT
+  public:
+    RomScanThread();
+    ~RomScanThread();
+
+    /**
+      Start looking through the given folder for (at most 'maxEntries')
+      ROMs of the given bankswitch type, or 4K.  Any scan already in
+      progress is cancelled first.
+    */
+    void scan(const QString& folder, BSType type, int maxEntries);
+
+    /** Stop the scan after the files currently being checked. */
+    void cancel() { myCancelled = true; }
+
+    /** The bankswitch type of the last scan started. */
+    BSType type() const { return myType; }
+
+  signals:
+    void scanStarted(int numFiles);
+    void romFound(int entry, const QString& menuName, const QString& fileName);
+    void scanProgress(int filesChecked);
+    void scanFinished(int numRoms, bool cancelled);
+
+  protected:
+    void run() override;
+
+  private:
+    QString myFolder;
+    BSType myType{BS_NONE};
+    int myMaxEntries{0};
+    std::atomic<bool> myCancelled{false};
+};
+
+#endif // ROM_SCAN_THREAD_HXX
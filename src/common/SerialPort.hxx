@@ -15,6 +15,9 @@
 #ifndef SERIAL_PORT_HXX
 #define SERIAL_PORT_HXX
 
+#include <atomic>
+#include <chrono>
+
 #include "bspf.hxx"
 
 /**
@@ -53,15 +56,24 @@ class SerialPort
 
     /**
       Sets (or resets) the timeout to the timout period requested.  Starts
-      counting to this period.  This timeout support is a little odd in that
-      the timeout specifies the accumulated deadtime waiting to read not the
-      total time waiting to read. They should be close enough to the same for
-      this use. Used by the serial input routines, the actual counting takes
-      place in receiveBlock.
+      counting to this period, as an absolute deadline on the monotonic
+      clock.  Used by the serial input routines; receiveBlock never waits
+      past this deadline.
 
       @param timeout_milliseconds  The time in milliseconds to use for timeout
     */
-    virtual void setTimeout(uInt32 timeout_milliseconds) = 0;
+    void setTimeout(uInt32 timeout_milliseconds)
+    {
+      myDeadline = Clock::now() + std::chrono::milliseconds(timeout_milliseconds);
+    }
+
+    /**
+      Answers if the device behind this port has disappeared (for example,
+      a USB adapter was unplugged).  Once this happens, all I/O fails
+      immediately until the port is opened again.
+    */
+    bool isLost() const { return myLost; }
+    void setLost()      { myLost = true; }
 
     /**
       Empty the serial port buffers.  Cleans things to a known state.
@@ -78,6 +90,13 @@ class SerialPort
     */
     virtual const StringList& getPortNames() = 0;
 
+    // A piece of data to send; several of these can make up one frame,
+    // and one call to send() can carry several frames
+    struct Segment {
+      const void* data;
+      uInt32 size;
+    };
+
     /**
       Utility function to write a string to the serial port, automatically
       determining the size of the block.
@@ -87,7 +106,47 @@ class SerialPort
     */
     uInt32 send(const void* data, uInt32 size = 0)
     {
-      return sendBlock(data, size == 0 ? strlen((const char*)data) : size);
+      Segment segment{data, size == 0 ? uInt32(strlen((const char*)data)) : size};
+      return send(&segment, 1);
+    }
+
+    /**
+      Write the given segments to the serial port, in order, without first
+      copying them into one buffer.  Partial writes are continued until
+      everything is sent, the timeout period has passed, or the port is lost.
+
+      @param segments  The data to write
+      @param count     The number of segments
+      @param timeout   The maximum amount of time to wait for the port to
+                       accept all the data (in milliseconds)
+      @return  The number of bytes written
+    */
+    uInt32 send(const Segment* segments, uInt32 count, uInt32 timeout = 1000)
+    {
+      uInt32 realsize = 0, index = 0, offset = 0;
+
+      setTimeout(timeout);
+      while(index < count && !myLost)
+      {
+        // Pass on what is left, starting partway into the current segment
+        Segment pending[MAX_SEGMENTS];
+        uInt32 num = 0;
+        for(uInt32 i = index; i < count && num < MAX_SEGMENTS; ++i)
+          pending[num++] = segments[i];
+        pending[0].data = (const uInt8*)pending[0].data + offset;
+        pending[0].size -= offset;
+
+        uInt32 written = sendVector(pending, num);
+        if(written == 0 && timeoutCheck())
+          break;
+
+        realsize += written;
+        offset += written;
+        while(index < count && offset >= segments[index].size)
+          offset -= segments[index++].size;
+      }
+
+      return realsize;
     }
 
     /**
@@ -109,7 +168,7 @@ class SerialPort
       do {
         read = receiveBlock(result + realsize, size - realsize);
         realsize += read;
-      } while ((realsize < size) && !timeoutCheck());
+      } while ((realsize < size) && !timeoutCheck() && !myLost);
 
       return realsize;
     }
@@ -151,7 +210,7 @@ class SerialPort
           }
         }
         RealSize += tmp_realsize;
-      } while ((RealSize < MaxSize) && !timeoutCheck() && (nr_of_0x0A < Wanted) && (nr_of_0x0D < Wanted) && !eof);
+      } while ((RealSize < MaxSize) && !timeoutCheck() && !myLost && (nr_of_0x0A < Wanted) && (nr_of_0x0D < Wanted) && !eof);
 
       Answer[RealSize] = 0;
       return RealSize;
@@ -189,9 +248,9 @@ class SerialPort
   protected:
     /**
       Receives a buffer from the open com port. Returns all the characters
-      ready (waits for up to 'n' milliseconds before accepting that no more
-      characters are ready) or when the buffer is full. 'n' is system dependent,
-      see SerialTimeout routines.
+      ready, waiting no longer than the deadline set by setTimeout() for
+      the first one to arrive, or when the buffer is full.  How precisely
+      the deadline is honoured is system dependent.
 
       @param answer    Buffer to hold the bytes read from the serial port
       @param max_size  The size of buffer pointed to by answer
@@ -200,39 +259,47 @@ class SerialPort
     virtual uInt32 receiveBlock(void* answer, uInt32 max_size) = 0;
 
     /**
-      Write block of bytes to the serial port.
+      Write as many of the given segments to the serial port as it will
+      accept in one go, waiting no longer than the deadline set by
+      setTimeout() for it to accept anything at all.
 
-      @param data  The byte(s) to write to the port
-      @param size  The size of the block
+      @param segments  The data to write
+      @param count     The number of segments (at most MAX_SEGMENTS)
       @return  The number of bytes written
     */
-    virtual uInt32 sendBlock(const void* data, uInt32 size) = 0;
+    virtual uInt32 sendVector(const Segment* segments, uInt32 count) = 0;
 
     /**
       Check to see if the serial timeout timer has run down.
 
       @return  True if timer has run out, false if timer still has time left
     */
-    bool timeoutCheck()
+    bool timeoutCheck() const
     {
-      return mySerialTimeoutCount == 0;
+      return Clock::now() >= myDeadline;
     }
 
     /**
-      Performs a timer tick.  In this simple case all we do is count down
-      with protection against underflow and wrapping at the low end.
+      Answers how much time is left before the current deadline expires.
+
+      @return  The time remaining (in microseconds), or zero if expired
     */
-    void timeoutTick()
+    Int64 timeRemaining() const
     {
-      if(mySerialTimeoutCount <= 1)
-        mySerialTimeoutCount = 0;
-      else
-        mySerialTimeoutCount--;
+      auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+          myDeadline - Clock::now()).count();
+      return left > 0 ? left : 0;
     }
 
   protected:
+    using Clock = std::chrono::steady_clock;
+
+    // The most segments passed to sendVector() at once
+    static constexpr uInt32 MAX_SEGMENTS = 64;
+
     uInt32 myBaud{9600};
-    uInt32 mySerialTimeoutCount{0};
+    Clock::time_point myDeadline;
+    std::atomic<bool> myLost{false};
     bool myControlLinesSwapped{false};
     string myID;
     StringList myPortNames;
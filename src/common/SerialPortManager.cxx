@@ -12,14 +12,20 @@
 // this file, and for a DISCLAIMER OF ALL WARRANTIES.
 //============================================================================
 
+#include <algorithm>
 #include <cstring>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
+#include "Cart.hxx"
 #include "SerialPortManager.hxx"
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 SerialPortManager::SerialPortManager()
+  : myBaudLadder{921600, 460800, 230400, 115200}
 {
-  myPort.setBaud(115200);
+  myPort.setBaud(myBaudRate);
   myPort.setControlSwap(false);
   myPort.closePort();
 }
@@ -27,13 +33,17 @@ SerialPortManager::SerialPortManager()
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 SerialPortManager::~SerialPortManager()
 {
+  myHotplugMonitor.stop();
   myPort.closePort();
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void SerialPortManager::setDefaultPort(const string& port)
+void SerialPortManager::setDefaultPort(const string& port, uInt32 baud)
 {
+  std::lock_guard<std::mutex> lock(myMutex);
   myPortName = port;
+  if(port != "" && baud > 0)
+    myPortBauds[port] = baud;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -45,32 +55,131 @@ void SerialPortManager::connectKrokCart()
   myVersionID = "";
 
   // Find (and open) the KrokCart serial port
+  // The port that was successful the last time is probed along with
+  // all the others
+  StringList ports = myPort.getPortNames();
+  if(myPortName != "" && !BSPF::contains(ports, myPortName))
+    ports.insert(ports.begin(), myPortName);
 
-  // First try the port that was successful the last time
-  if(myPortName != "" && connect(myPortName))
+  KrokCartList found = probePorts(ports, true);
+  if(!found.empty())
   {
-    // myPortName already contains the correct name
+    std::lock_guard<std::mutex> lock(myMutex);
+    myFoundKrokCart = true;
+    myPortName = found[0].portName;
+    myVersionID = found[0].versionID;
+    myBaudRate = found[0].baud;
+
+    // Re-initialize the port; make sure we start in a known state
+    myPort.setBaud(myBaudRate);
+    myPort.openPort(myPortName);
   }
-  else  // Search through all ports
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+SerialPortManager::KrokCartList SerialPortManager::findAllKrokCarts()
+{
+  // The connected cart (if any) must be released, so it can be probed too
+  myPort.closePort();
+  myFoundKrokCart = false;
+
+  StringList ports = myPort.getPortNames();
+  if(myPortName != "" && !BSPF::contains(ports, myPortName))
+    ports.insert(ports.begin(), myPortName);
+
+  KrokCartList found = probePorts(ports, false);
+  std::sort(found.begin(), found.end(),
+      [](const KrokCart& a, const KrokCart& b) { return a.portName < b.portName; });
+
+  return found;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+SerialPortManager::KrokCartList
+SerialPortManager::probePorts(const StringList& ports, bool firstOnly)
+{
+  Search search;
+  search.deadline = Clock::now() + std::chrono::milliseconds(PORT_SEARCH_TIMEOUT);
+
+  std::mutex mutex;
+  std::condition_variable finished;
+  size_t remaining = ports.size();
+  KrokCartList found;
+
+  vector<std::thread> probes;
+  for(const auto& device: ports)
+  {
+    auto it = myPortBauds.find(device);
+    uInt32 lastBaud = it != myPortBauds.end() ? it->second : 0;
+
+    probes.emplace_back([&, device, lastBaud]() {
+      SerialPortType port;
+      KrokCart cart{device, "", 0};
+      bool success = probeAtBestRate(port, device, lastBaud,
+                                     cart.versionID, cart.baud, search);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if(success && !(firstOnly && !found.empty()))
+      {
+        found.push_back(cart);
+        if(firstOnly)
+          search.done = true;  // Tell all other probes to give up
+      }
+      --remaining;
+      finished.notify_one();
+    });
+  }
+
+  // Wait for the first KrokCart to answer (if only one is needed), all
+  // probes to finish, or time to run out
   {
-    const StringList& ports = myPort.getPortNames();
-    for(uInt32 i = 0; i < ports.size(); ++i)
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait_until(lock, search.deadline,
+        [&]() { return remaining == 0 || (firstOnly && !found.empty()); });
+    search.done = true;
+  }
+  for(auto& t: probes)
+    t.join();
+
+  // Remember the rates that worked, to try them first next time
+  for(const auto& cart: found)
+    myPortBauds[cart.portName] = cart.baud;
+
+  return found;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortManager::probeAtBestRate(SerialPort& port, const string& device,
+    uInt32 lastBaud, string& version, uInt32& baud, const Search& search) const
+{
+  // The rate that worked the last time is the most likely to work again
+  if(lastBaud > 0 && probe(port, device, lastBaud, version, search))
+  {
+    baud = lastBaud;
+    return true;
+  }
+
+  // Otherwise fall back through the ladder, fastest rate first
+  for(auto rate: myBaudLadder)
+  {
+    if(search.done)
+      break;
+    if(rate != lastBaud && probe(port, device, rate, version, search))
     {
-      if(connect(ports[i]))
-        break;
+      baud = rate;
+      return true;
     }
   }
 
-  // Re-initialize the port; make sure we start in a known state
-  myPort.closePort();
-  if(myFoundKrokCart)
-    myPort.openPort(myPortName);
+  return false;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-bool SerialPortManager::connect(const string& device)
+bool SerialPortManager::probe(SerialPort& port, const string& device, uInt32 baud,
+                              string& version, const Search& search)
 {
-  if(myPort.openPort(device))
+  port.setBaud(baud);
+  if(port.openPort(device))
   {
     uInt8 tx[100];   // transmit buffer
     uInt8 rx[100];   // receive  buffer
@@ -89,13 +198,13 @@ bool SerialPortManager::connect(const string& device)
     // -------------------------------------------------------------
     // Search for KrokCart device
     // -------------------------------------------------------------
-    if(myPort.sendBlock(tx, 2) == 0)
+    if(port.send(tx, 2) == 0)
     {
-      myPort.closePort();
+      port.closePort();
       return false;
     }
     // Wait for device to respond to command (get ACK)
-    myPort.receiveBlock(rx, 1);
+    receiveByte(port, rx, search);
 
     // -------------------------------------------------------------
     // If ACK is not sent, the device is not present
@@ -104,27 +213,75 @@ bool SerialPortManager::connect(const string& device)
     int BytesRead = 0;
     do
     {
-      BytesRead = myPort.receiveBlock(rx, 1);
+      BytesRead = receiveByte(port, rx, search);
       ver[VCnt++] = rx[0];
     }
-    while(rx[0] != 0 && VCnt < 100 && BytesRead > 0);
+    while(rx[0] != 0 && VCnt < 99 && BytesRead > 0);
     if(VCnt > 10)
-      myPort.sendBlock(tx, 1);  // Send an Ack
+      port.send(tx, 1);  // Send an Ack
 
-    myPort.closePort();
+    port.closePort();
 
     if(ver[0] != 0 && VCnt > 10)
     {
-      myFoundKrokCart = true;
-      myPortName = device;
-      myVersionID = (const char*)ver;
+      version = (const char*)ver;
       return true;
     }
   }
+  port.closePort();
 
   return false;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 SerialPortManager::receiveByte(SerialPort& port, uInt8* byte, const Search& search)
+{
+  // Wait in short slices, so an abandoned probe finishes quickly
+  for(int slice = 0; slice < 5; ++slice)
+  {
+    if(search.done || Clock::now() >= search.deadline)
+      break;
+    if(port.receive(byte, 1, 20) == 1)
+      return 1;
+  }
+  return 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortManager::startHotplugMonitor(const HotplugMonitor::Callback& callback)
+{
+  myHotplugCallback = callback;
+  return myHotplugMonitor.start(
+      [this](const string& device, bool added) { hotplugEvent(device, added); });
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortManager::stopHotplugMonitor()
+{
+  myHotplugMonitor.stop();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortManager::hotplugEvent(const string& device, bool added)
+{
+  if(!added)
+  {
+    std::lock_guard<std::mutex> lock(myMutex);
+    if(myFoundKrokCart && device == myPortName)
+    {
+      // Fail any I/O in progress now, rather than waiting for it to time out
+      myFoundKrokCart = false;
+      myPort.setLost();
+    }
+
+    // Whatever cart is plugged in next may not hold the last download
+    Cart::forgetDevice(device);
+  }
+
+  if(myHotplugCallback)
+    myHotplugCallback(device, added);
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool SerialPortManager::krokCartAvailable() const
 {
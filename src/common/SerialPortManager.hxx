@@ -19,39 +19,145 @@
 
 #if defined(BSPF_MACOS)
   #include "SerialPortMACOS.hxx"
+  using SerialPortType = SerialPortMACOS;
 #elif defined(BSPF_UNIX)
   #include "SerialPortUNIX.hxx"
+  using SerialPortType = SerialPortUNIX;
 #else
   #error Unsupported platform!
 #endif
 
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include "HotplugMonitor.hxx"
+
+// Maximum time (in milliseconds) allowed for searching all ports
+#define PORT_SEARCH_TIMEOUT 3000
+
 class SerialPortManager
 {
+  public:
+    // A KrokCart found during a search, and how to talk to it
+    struct KrokCart {
+      string portName;
+      string versionID;
+      uInt32 baud{0};
+    };
+    using KrokCartList = vector<KrokCart>;
+
   public:
     SerialPortManager();
     ~SerialPortManager();
 
-    void setDefaultPort(const string& port);
+    /**
+      Set the port (and the baud rate that last worked on it) to try
+      first when looking for a KrokCart.
+    */
+    void setDefaultPort(const string& port, uInt32 baud = 0);
+
+    /**
+      Set the baud rates to attempt on each port, fastest first.  The rate
+      that worked last time on a port is always attempted first.
+    */
+    void setBaudLadder(const uIntArray& rates) { myBaudLadder = rates; }
+    const uIntArray& baudLadder() const { return myBaudLadder; }
+
+    /**
+      Search for a KrokCart, probing all candidate ports at the same time.
+      The first port to return a valid version string wins, and the
+      remaining probes are abandoned.
+    */
     void connectKrokCart();
     bool krokCartAvailable() const;
 
+    /**
+      Search for every KrokCart attached to the system, probing all
+      candidate ports at the same time.  The carts are not opened; each
+      one should be driven through its own port object, so that several
+      can be written in parallel.
+
+      @return  The carts that answered, sorted by port name
+    */
+    KrokCartList findAllKrokCarts();
+
+    /**
+      Start watching for KrokCarts being plugged in or removed.  Removing
+      the connected cart immediately marks it as unavailable, and makes
+      any transfer in progress fail at once.  The callback (which is run
+      from the monitor thread) is told about every change, so that a newly
+      added cart can be searched for in the background.
+
+      @return  False if hotplug events aren't supported, else true
+    */
+    bool startHotplugMonitor(const HotplugMonitor::Callback& callback);
+    void stopHotplugMonitor();
+
     SerialPort& port();
     const string& portName() const;
     const string& versionID() const;
+    uInt32 baudRate() const { return myBaudRate; }
 
   private:
-    bool connect(const string& device);
+    using Clock = std::chrono::steady_clock;
+
+    // Shared by all probes taking part in a search
+    struct Search {
+      std::atomic<bool> done{false};
+      Clock::time_point deadline;
+    };
+
+    /**
+      Probe the given ports in parallel, returning the KrokCarts that
+      answered.  When 'firstOnly' is set, the search ends as soon as one
+      cart is found.
+    */
+    KrokCartList probePorts(const StringList& ports, bool firstOnly);
+
+    /**
+      Attempt to find a KrokCart on the given port, walking down the
+      baud rate ladder (starting with 'lastBaud', if non-zero) until a
+      version handshake succeeds.  Safe to call from several threads,
+      each with its own port object.
+    */
+    bool probeAtBestRate(SerialPort& port, const string& device, uInt32 lastBaud,
+                         string& version, uInt32& baud, const Search& search) const;
+
+    /**
+      Query the version info from a KrokCart on the given port and rate.
+    */
+    static bool probe(SerialPort& port, const string& device, uInt32 baud,
+                      string& version, const Search& search);
+
+    /**
+      Wait (for up to 100 ms) for a single byte from the KrokCart,
+      giving up early once the search is over.
+    */
+    static uInt32 receiveByte(SerialPort& port, uInt8* byte, const Search& search);
+
+    /**
+      Called from the hotplug monitor thread when a device comes or goes.
+    */
+    void hotplugEvent(const string& device, bool added);
 
   private:
-  #if defined(BSPF_MACOS)
-    SerialPortMACOS myPort;
-  #elif defined(BSPF_UNIX)
-    SerialPortUNIX myPort;
-  #endif
+    SerialPortType myPort;
 
-    bool myFoundKrokCart{false};
+    std::atomic<bool> myFoundKrokCart{false};
     string myPortName;
     string myVersionID;
+    uInt32 myBaudRate{115200};
+
+    // Rates to attempt, and the rate that won the last time on each port
+    uIntArray myBaudLadder;
+    std::map<string, uInt32> myPortBauds;
+
+    // Guards the port name, which the hotplug thread also looks at
+    std::mutex myMutex;
+    HotplugMonitor::Callback myHotplugCallback;
+    HotplugMonitor myHotplugMonitor;
 };
 
 #endif // SERIAL_PORT_MANAGER_HXX
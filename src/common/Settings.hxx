@@ -0,0 +1,38 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef SETTINGS_HXX
+#define SETTINGS_HXX
+
+#include "bspf.hxx"
+
+/**
+  Persistent settings for programs that don't link Qt (the GUI uses
+  QSettings directly), stored as strings under a group and key.  They
+  are kept in a plain text file, by SettingsFile.cxx.
+
+  @author  Stephen Anthony
+*/
+class Settings
+{
+  public:
+    static string value(const string& group, const string& key,
+                        const string& defaultValue = "");
+    static void setValue(const string& group, const string& key, const string& value);
+
+  private:
+    Settings() = delete;
+};
+
+#endif // SETTINGS_HXX
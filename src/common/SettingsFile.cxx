@@ -0,0 +1,85 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#include "Settings.hxx"
+
+// Settings are kept in '$HOME/.KCSETTINGS.txt', one per line, as
+// <group> TAB <key> TAB <value>
+using SettingsMap = std::map<std::pair<string, string>, string>;
+static std::mutex ourMutex;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static string settingsFile()
+{
+  const char* home = getenv("HOME");
+  return string(home ? home : ".") + "/.KCSETTINGS.txt";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static SettingsMap load()
+{
+  SettingsMap settings;
+  std::ifstream in(settingsFile());
+  string line;
+  while(std::getline(in, line))
+  {
+    size_t tab1 = line.find('\t'), tab2 = line.find('\t', tab1 + 1);
+    if(tab1 != string::npos && tab2 != string::npos)
+      settings[{ line.substr(0, tab1), line.substr(tab1 + 1, tab2 - tab1 - 1) }] =
+          line.substr(tab2 + 1);
+  }
+  return settings;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static void save(const SettingsMap& settings)
+{
+  // Write a new file and move it into place, so a reader never sees
+  // half a file
+  string file = settingsFile(), temp = file + ".tmp";
+  {
+    std::ofstream out(temp);
+    for(const auto& [key, value]: settings)
+      out << key.first << '\t' << key.second << '\t' << value << '\n';
+    if(!out)
+      return;
+  }
+  std::rename(temp.c_str(), file.c_str());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string Settings::value(const string& group, const string& key,
+                       const string& defaultValue)
+{
+  std::lock_guard<std::mutex> lock(ourMutex);
+  SettingsMap settings = load();
+  auto it = settings.find({ group, key });
+
+  return it != settings.end() ? it->second : defaultValue;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Settings::setValue(const string& group, const string& key, const string& value)
+{
+  std::lock_guard<std::mutex> lock(ourMutex);
+  SettingsMap settings = load();
+  settings[{ group, key }] = value;
+  save(settings);
+}
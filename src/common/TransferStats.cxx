@@ -0,0 +1,176 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include "TransferStats.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TransferStats::reset(bool download)
+{
+  *this = TransferStats();
+  myDownload = download;
+  myStartTime = myEndTime = Clock::now();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TransferStats::sent(uInt32 bytes, Clock::duration time)
+{
+  myBytesSent += bytes;
+  mySendTime += time;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TransferStats::received(uInt32 bytes, Clock::duration time)
+{
+  myBytesReceived += bytes;
+  myWaitTime += time;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TransferStats::sectorStarted(uInt16 sector)
+{
+  // A retried sector keeps its original start time, so the round trip
+  // includes the cost of the retries
+  myInFlight.emplace(sector, Clock::now());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 TransferStats::sectorFinished(uInt16 sector)
+{
+  myEndTime = Clock::now();
+
+  uInt32 usec = 0;
+  auto it = myInFlight.find(sector);
+  if(it != myInFlight.end())
+  {
+    usec = uInt32(std::chrono::duration_cast<std::chrono::microseconds>(
+        myEndTime - it->second).count());
+    myRoundTrips.push_back(usec);
+    myFinished.set(sector);
+    myInFlight.erase(it);
+  }
+  return usec;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double TransferStats::elapsedTime() const
+{
+  return toSeconds(myEndTime - myStartTime);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 TransferStats::roundTrip(double percentile) const
+{
+  if(myRoundTrips.empty())
+    return 0;
+
+  vector<uInt32> sorted = myRoundTrips;
+  size_t index = size_t(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+  index = std::min(index, sorted.size() - 1);
+  std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+
+  return sorted[index];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double TransferStats::throughput() const
+{
+  double secs = elapsedTime();
+  return secs > 0 ? sectors() * 256 / 1024.0 / secs : 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string TransferStats::summary() const
+{
+  ostringstream out;
+  out << std::fixed << std::setprecision(1) << throughput() << " KB/s, "
+      << "RTT " << std::setprecision(1) << roundTrip(50) / 1000.0 << " ms, "
+      << myRetries << (myRetries == 1 ? " retry" : " retries");
+
+  return out.str();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string TransferStats::details() const
+{
+  ostringstream out;
+  out << std::fixed << std::setprecision(3)
+      << (myDownload ? "Download" : "Verify") << " of " << sectors() << " sectors in "
+      << elapsedTime() << " s (" << std::setprecision(1) << throughput() << " KB/s)" << std::endl
+      << "Bytes sent / received: " << myBytesSent << " / " << myBytesReceived << std::endl
+      << "Sector round trip (ms): median " << std::setprecision(2) << roundTrip(50) / 1000.0
+      << ", 99% " << roundTrip(99) / 1000.0 << ", max " << roundTrip(100) / 1000.0 << std::endl
+      << "Time sending / waiting (s): " << std::setprecision(3) << sendTime()
+      << " / " << waitTime() << std::endl
+      << "Retries: " << myRetries << " (" << mySectorRetries.size() << " sectors)" << std::endl
+      << "Checksum errors: " << myChecksumErrors << std::endl
+      << "Data mismatches: " << myDataMismatches << std::endl
+      << "Undefined responses: " << myUndefinedResponses << std::endl
+      << "Timeouts: " << myTimeouts;
+
+  return out.str();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string TransferStats::toJSON(const string& device) const
+{
+  ostringstream out;
+  out << std::fixed << std::setprecision(6) << "{";
+  if(device != "")
+    out << "\"device\":" << jsonString(device) << ",";
+  out << "\"pass\":\"" << (myDownload ? "download" : "verify") << "\""
+      << ",\"sectors\":" << sectors()
+      << ",\"elapsed\":" << elapsedTime()
+      << ",\"kbPerSec\":" << throughput()
+      << ",\"bytesSent\":" << myBytesSent
+      << ",\"bytesReceived\":" << myBytesReceived
+      << ",\"sendTime\":" << sendTime()
+      << ",\"waitTime\":" << waitTime()
+      << ",\"rttUsec\":{\"p50\":" << roundTrip(50) << ",\"p90\":" << roundTrip(90)
+      << ",\"p99\":" << roundTrip(99) << ",\"max\":" << roundTrip(100) << "}"
+      << ",\"retries\":" << myRetries
+      << ",\"checksumErrors\":" << myChecksumErrors
+      << ",\"dataMismatches\":" << myDataMismatches
+      << ",\"undefinedResponses\":" << myUndefinedResponses
+      << ",\"timeouts\":" << myTimeouts
+      << ",\"sectorRetries\":{";
+  bool first = true;
+  for(const auto& [sector, count]: mySectorRetries)
+  {
+    out << (first ? "" : ",") << "\"" << sector << "\":" << count;
+    first = false;
+  }
+  out << "}}";
+
+  return out.str();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string TransferStats::jsonString(const string& s)
+{
+  ostringstream out;
+  out << "\"";
+  for(char c: s)
+  {
+    if(c == '"' || c == '\\')
+      out << '\\' << c;
+    else if(uInt8(c) < 0x20)
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c)
+          << std::dec << std::setfill(' ');
+    else
+      out << c;
+  }
+  out << "\"";
+
+  return out.str();
+}
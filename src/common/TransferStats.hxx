@@ -0,0 +1,133 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef TRANSFER_STATS_HXX
+#define TRANSFER_STATS_HXX
+
+#include <bitset>
+#include <chrono>
+#include <map>
+
+#include "bspf.hxx"
+
+/**
+  This class collects statistics for a single download or verify pass,
+  as the transfer runs.  Cart fills it in; the UI and commandline only
+  read it, to help track down slow adapters and flaky cables.
+
+  The round-trip time of a sector is measured from when its command is
+  sent until the KrokCart's reply has been fully received (including
+  any time spent queued behind other sectors in the download window).
+
+  @author  Stephen Anthony
+*/
+class TransferStats
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    TransferStats() = default;
+
+    /**
+      Clear all statistics, in preparation for a new pass.
+    */
+    void reset(bool download);
+
+    //////////////////////////////////////////////////////////////////
+    //  The following methods are used by Cart to record events
+    //////////////////////////////////////////////////////////////////
+    void sent(uInt32 bytes, Clock::duration time);
+    void received(uInt32 bytes, Clock::duration time);
+    void sectorStarted(uInt16 sector);
+    uInt32 sectorFinished(uInt16 sector);  // returns the round trip in usec
+    void retry(uInt16 sector)  { ++myRetries; ++mySectorRetries[sector]; }
+    void checksumError()       { ++myChecksumErrors;     }
+    void dataMismatch()        { ++myDataMismatches;     }
+    void undefinedResponse()   { ++myUndefinedResponses; }
+    void timeout()             { ++myTimeouts;           }
+
+    //////////////////////////////////////////////////////////////////
+    //  Accessors
+    //////////////////////////////////////////////////////////////////
+    bool   isDownload() const         { return myDownload;           }
+    uInt64 bytesSent() const          { return myBytesSent;          }
+    uInt64 bytesReceived() const      { return myBytesReceived;      }
+    uInt32 sectors() const            { return uInt32(myFinished.count()); }
+    uInt32 retries() const            { return myRetries;            }
+    uInt32 checksumErrors() const     { return myChecksumErrors;     }
+    uInt32 dataMismatches() const     { return myDataMismatches;     }
+    uInt32 undefinedResponses() const { return myUndefinedResponses; }
+    uInt32 timeouts() const           { return myTimeouts;           }
+
+    /** Retries needed for each sector that needed any. */
+    const std::map<uInt16, uInt32>& sectorRetries() const { return mySectorRetries; }
+
+    /** Time (in seconds) spent sending, waiting for replies, and in total. */
+    double sendTime() const { return toSeconds(mySendTime); }
+    double waitTime() const { return toSeconds(myWaitTime); }
+    double elapsedTime() const;
+
+    /** Sector round-trip times, in microseconds. */
+    const vector<uInt32>& roundTrips() const { return myRoundTrips; }
+    uInt32 roundTrip(double percentile) const;
+
+    /** Data moved in KB/s (sector payload only, not protocol overhead). */
+    double throughput() const;
+
+    /**
+      A short, human-readable summary (for the status bar), and a longer
+      one with one item per line.
+    */
+    string summary() const;
+    string details() const;
+
+    /**
+      All statistics as a single-line JSON object, for use by scripts.
+      The device the transfer used is included, if given.
+    */
+    string toJSON(const string& device = "") const;
+
+  private:
+    static double toSeconds(Clock::duration d) {
+      return std::chrono::duration<double>(d).count();
+    }
+
+    /** Quote a string for use as a JSON value. */
+    static string jsonString(const string& s);
+
+  private:
+    bool myDownload{true};
+    uInt64 myBytesSent{0};
+    uInt64 myBytesReceived{0};
+    uInt32 myRetries{0};
+    uInt32 myChecksumErrors{0};
+    uInt32 myDataMismatches{0};  // valid frame, but not the data we wrote
+    uInt32 myUndefinedResponses{0};
+    uInt32 myTimeouts{0};
+
+    Clock::duration mySendTime{0};
+    Clock::duration myWaitTime{0};
+    Clock::time_point myStartTime, myEndTime;
+
+    // Time each sector still in flight was started, and the results so far
+    std::map<uInt16, Clock::time_point> myInFlight;
+    vector<uInt32> myRoundTrips;
+
+    // Each sector is only counted once, even if it was both written and
+    // read back during the same pass
+    std::bitset<2048> myFinished;
+    std::map<uInt16, uInt32> mySectorRetries;
+};
+
+#endif // TRANSFER_STATS_HXX
@@ -0,0 +1,178 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <QMutexLocker>
+
+#include "TransferThread.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TransferThread::TransferThread(SerialPortManager& manager)
+  : QThread(),
+    myManager(manager)
+{
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TransferThread::~TransferThread()
+{
+  cancel();
+  wait();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TransferThread::queueJob(JobType type, const Cart& cart, bool autoVerify)
+{
+  QMutexLocker lock(&myMutex);
+  myJobs.push_back(std::unique_ptr<Job>(new Job{type, cart, autoVerify}));
+
+  // The thread exits once the queue is empty; restart it if necessary
+  // (it may still be finishing up, so wait for that first)
+  if(!myActive)
+  {
+    myActive = true;
+    wait();
+    start();
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TransferThread::cancel()
+{
+  QMutexLocker lock(&myMutex);
+  myJobs.clear();
+  myCancelled = true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool TransferThread::busy()
+{
+  QMutexLocker lock(&myMutex);
+  return myActive;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TransferThread::run()
+{
+  JobType lastType = Verify;
+  for(;;)
+  {
+    std::unique_ptr<Job> job;
+    {
+      QMutexLocker lock(&myMutex);
+      if(myJobs.empty())
+      {
+        myActive = false;
+        return;
+      }
+      job = std::move(myJobs.front());
+      myJobs.pop_front();
+      myCancelled = false;
+    }
+
+    if(job->type == Download)
+    {
+      // Verify the image that was just written (the UI may well have
+      // loaded another one by now), unless every sector was already
+      // read back as it was written
+      if(download(job->cart) && job->autoVerify && !job->cart.getVerifyWrites())
+      {
+        QMutexLocker lock(&myMutex);
+        if(!myCancelled)
+        {
+          job->type = Verify;
+          job->autoVerify = false;
+          myJobs.push_front(std::move(job));
+          lastType = Download;
+          continue;
+        }
+      }
+    }
+    else
+    {
+      // It seems we must wait a while before attempting a verify
+      if(lastType == Download)
+        myManager.port().sleepMillis(100);
+      verify(job->cart);
+    }
+    lastType = job->type;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool TransferThread::download(Cart& cart)
+{
+  SerialPort& port = myManager.port();
+  cart.setDevice(myManager.portName());
+  uInt16 sector = 0, numSectors = cart.initSectors(true);
+  emit jobStarted(Download, numSectors);
+
+  try
+  {
+    for(sector = 0; sector < numSectors && !myCancelled; ++sector)
+    {
+      cart.writeNextSector(port);
+      emit jobProgress(sector + 1);
+    }
+
+    // Sectors already in flight must still be acknowledged, so the
+    // KrokCart is in a known state for the next job
+    if(myCancelled)
+      cart.flushSectors(port);
+  }
+  catch(const char* msg)
+  {
+    cout << msg << std::endl;
+  }
+
+  emit jobStats(cart.stats().summary().c_str(), cart.stats().details().c_str());
+
+  bool success = cart.finalizeSectors();
+  QString message = cart.message().c_str();
+  if(!success && myCancelled)
+    message = "Download cancelled after " + QString::number(sector) + " sectors.";
+
+  emit jobFinished(Download, success, message);
+  return success;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TransferThread::verify(Cart& cart)
+{
+  SerialPort& port = myManager.port();
+  uInt16 sector = 0, numSectors = cart.initSectors(false);
+  emit jobStarted(Verify, numSectors);
+
+  try
+  {
+    for(sector = 0; sector < numSectors && !myCancelled; ++sector)
+    {
+      cart.verifyNextSector(port);
+      emit jobProgress(sector + 1);
+    }
+  }
+  catch(const char* msg)
+  {
+    cout << msg << std::endl;
+  }
+
+  emit jobStats(cart.stats().summary().c_str(), cart.stats().details().c_str());
+
+  if(sector == numSectors)
+    emit jobFinished(Verify, true, "Verified download of " +
+                     QString::number(cart.stats().sectors()) + " sectors.");
+  else if(myCancelled)
+    emit jobFinished(Verify, false, "Verify cancelled after " + QString::number(sector) + " sectors.");
+  else
+    emit jobFinished(Verify, false, "Verify failure on sector " + QString::number(sector) + ".");
+}
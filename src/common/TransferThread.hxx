@@ -0,0 +1,94 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef TRANSFER_THREAD_HXX
+#define TRANSFER_THREAD_HXX
+
+#include <QThread>
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+#include <deque>
+
+#include "Cart.hxx"
+#include "SerialPortManager.hxx"
+
+/**
+  This class runs downloads and verifies to the KrokCart in a separate
+  thread, in the same way as FindKrokThread does for port searching.
+  Jobs are queued and processed in order; each one works on its own copy
+  of the cart, so the UI is free to load another ROM (and queue another
+  job) while a transfer is in progress.
+
+  Progress is reported through signals, which are delivered to the UI
+  thread as queued connections.  A transfer can be cancelled between
+  sectors, which also discards any jobs still waiting in the queue.
+
+  @author  Stephen Anthony
+*/
+class TransferThread: public QThread
+{
+Q_OBJECT
+  public:
+    enum JobType { Download = 0, Verify = 1 };
+
+    TransferThread(SerialPortManager& manager);
+    ~TransferThread();
+
+    /**
+      Add a job for the given cart to the queue, starting the thread
+      if it isn't already running.  With 'autoVerify', a successful
+      download is followed by a verify of the same cart.
+    */
+    void queueJob(JobType type, const Cart& cart, bool autoVerify = false);
+
+    /**
+      Stop the current job at the next sector boundary, and throw away
+      any jobs still waiting in the queue.
+    */
+    void cancel();
+
+    /** Is a job currently running or waiting to run? */
+    bool busy();
+
+  signals:
+    void jobStarted(int type, int numSectors);
+    void jobProgress(int sectors);
+    void jobFinished(int type, bool success, const QString& message);
+    void jobStats(const QString& summary, const QString& details);
+
+  protected:
+    void run() override;
+
+  private:
+    struct Job {
+      JobType type;
+      Cart cart;
+      bool autoVerify;
+    };
+
+    bool download(Cart& cart);
+    void verify(Cart& cart);
+
+  private:
+    SerialPortManager& myManager;
+
+    QMutex myMutex;
+    std::deque<std::unique_ptr<Job>> myJobs;
+    bool myActive{false};
+    std::atomic<bool> myCancelled{false};
+};
+
+#endif // TRANSFER_THREAD_HXX
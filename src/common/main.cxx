@@ -16,156 +16,27 @@
 #include <cstring>
 
 #include "bspf.hxx"
-#include "Cart.hxx"
-#include "SerialPort.hxx"
-#include "SerialPortManager.hxx"
+#include "CommandLine.hxx"
 #include "KrokComWindow.hxx"
-#include "Version.hxx"
-
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void runCommandlineApp(KrokComWindow& win, int ac, char* av[])
-{
-  string bstype = "", romfile = "";
-  bool incremental = false, autoverify = false;
-
-  // Parse commandline args
-  for(int i = 1; i < ac; ++i)
-  {
-    if(strstr(av[i], "-bs=") == av[i])
-      bstype = av[i]+4;
-    else if(!strcmp(av[i], "-id"))
-      incremental = true;
-    else if(!strcmp(av[i], "-av"))
-      autoverify = true;
-    else
-      romfile = av[i];
-  }
-
-  SerialPortManager& manager = win.portManager();
-  manager.connectKrokCart();
-  if(manager.krokCartAvailable())
-  {
-    cout << "KrokCart: \'" << manager.versionID().c_str() << "\'"
-         << " @ \'" << manager.portName().c_str() << "\'" << std::endl;
-  }
-  else
-  {
-    cout << "KrokCart not detected" << std::endl;
-    return;
-  }
-
-  // Create a new cart for writing
-  Cart cart;
-
-  // Create a new single-load cart
-  cart.create(romfile, bstype);
-  cart.setIncremental(incremental);
-
-  // Write to serial port
-  if(cart.isValid())
-  {
-    try
-    {
-      cout << std::endl;
-      uInt16 sector = 0, numSectors = cart.initSectors(true);
-      while(sector < numSectors)
-      {
-        uInt16 lower = cart.currentSector();
-        uInt16 upper = lower + std::min(15, int(numSectors-sector-1));
-
-        cout << "Sectors " << std::setw(4) << lower << " - " << std::setw(4) << upper << " | ";
-        for(uInt16 col = 0; col < 16; ++col)
-        {
-          if(sector < numSectors)
-          {
-            cart.writeNextSector(manager.port());
-            ++sector;
-            cout << "." << std::flush;
-          }
-          else
-            cout << " " << std::flush;
-        }
-        cout << " | successfully sent : " << std::setw(3) << (100*sector/numSectors) << "% complete" << std::endl;
-      }
-    }
-    catch(const char* msg)
-    {
-      cout << msg << std::endl;
-    }
-
-    if(cart.finalizeSectors())
-    {
-      cout << cart.message().c_str() << std::endl;
-
-      // See if we should automatically verify the download
-      if(autoverify)
-      {
-        // It seems we must wait a while before attempting a verify
-        manager.port().sleepMillis(100);
-        try
-        {
-          uInt16 sector = 0, numSectors = cart.initSectors(false);
-          while(sector < numSectors)
-          {
-            uInt16 lower = cart.currentSector();
-            uInt16 upper = lower + std::min(15, (int)(numSectors-sector-1));
-
-            cout << std::endl << "Sectors " << std::setw(4) << lower << " - " << std::setw(4) << upper << " | ";
-            for(uInt16 col = 0; col < 16; ++col)
-            {
-              if(sector < numSectors)
-              {
-                cart.verifyNextSector(manager.port());
-                ++sector;
-                cout << "." << std::flush;
-              }
-              else
-                cout << " " << std::flush;
-            }
-            cout << " | successfully verified : " << std::setw(3) << (100*sector/numSectors) << "% complete" << std::endl;
-          }
-        }
-        catch(const char* msg)
-        {
-          cout << msg << std::endl;
-        }
-      }
-    }
-    else
-      cout << cart.message().c_str() << std::endl;
-  }
-  else
-    cout << "ERROR: Invalid cartridge, not written" << std::endl;
-}
+#include "KrokDaemon.hxx"
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 int main(int ac, char* av[])
 {
   if(ac == 2 && !strcmp(av[1], "-help"))
   {
-    cout << "Krokodile Commander for UNIX version " << KROK_VERSION << std::endl
-         << "  https://github.com/sa666666/krokcom" << std::endl
-         << std::endl
-         << "Usage: krokcom [options ...] datafile" << std::endl
-         << "       Run without any options or datafile to use the graphical frontend" << std::endl
-         << "       Consult the manual for more in-depth information" << std::endl
-         << std::endl
-         << "Valid options are:" << std::endl
-         << std::endl
-         << "  -bs=[type]  Specify the bankswitching scheme for a ROM image (default is 'auto')" << std::endl
-         << "  -av         Automatically verify after a download is successfully completed" << std::endl
-         << "  -id         Perform an incremental download (only download changes since last time)" << std::endl
-         << "  -help       Displays the message you're now reading" << std::endl
-         << std::endl
-         << "This software is Copyright (c) 2009-2025 Stephen Anthony, and is released" << std::endl
-         << "under the GNU GPL version 3." << std::endl
-         << std::endl;
+    CommandLine::usage("krokcom", true);
     return 0;
   }
 
+  // Requests for a daemon need neither Qt nor a KrokCart
+  if(ac >= 2 && strstr(av[1], "-remote") == av[1])
+    return CommandLine::remote(av[1][7] == '=' ? string(av[1]+8) : KrokDaemon::defaultSocketPath(),
+                               ac - 2, av + 2);
+
   // The application and window needs to be created even if we're using
   // commandline mode, since the settings are controlled by a QSettings
-  // object which needs a Qt context.
+  // object which needs a Qt context (the 'krokcli' program does without).
   QApplication app(ac, av);
   KrokComWindow win;
 
@@ -173,13 +44,17 @@ int main(int ac, char* av[])
   {
     // Only start a 'connect' thread if we're in UI mode
     win.connectKrokCart();
+    win.startHotplugMonitor();
     win.show();
     return app.exec();
   }
+  else if(ac == 2 && strstr(av[1], "-daemon") == av[1])
+  {
+    return CommandLine::daemon(win.portManager(),
+        av[1][7] == '=' ? string(av[1]+8) : KrokDaemon::defaultSocketPath());
+  }
   else  // Assume we're working from the commandline
   {
-    runCommandlineApp(win, ac, av);
+    return CommandLine::run(win.portManager(), ac, av) ? 0 : 1;
   }
-
-  return 0;
 }
@@ -14,10 +14,12 @@
 
 #include <cstdio>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/errno.h>
 #include <sys/termios.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <cstring>
 
@@ -39,6 +41,7 @@ SerialPortMACOS::~SerialPortMACOS()
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool SerialPortMACOS::openPort(const string& device)
 {
+  myLost = false;
   myHandle = open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
   if(myHandle < 0)
     return false;
@@ -124,23 +127,72 @@ uInt32 SerialPortMACOS::receiveBlock(void* answer, uInt32 max_size)
   uInt32 result = 0;
   if(myHandle)
   {
-    result = read(myHandle, answer, max_size);
-    if(result == 0)
-      timeoutTick();
+    // Each read waits for at most VTIME; the caller checks the deadline
+    ssize_t n = read(myHandle, answer, max_size);
+    if(n > 0)
+      result = uInt32(n);
+    else if(n < 0 && (errno == EIO || errno == ENXIO || errno == ENODEV))
+      myLost = true;  // The device has been unplugged
   }
   return result;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-uInt32 SerialPortMACOS::sendBlock(const void* data, uInt32 size)
+uInt32 SerialPortMACOS::sendVector(const Segment* segments, uInt32 count)
 {
-  return myHandle ? write(myHandle, data, size) : 0;
-}
+  if(!myHandle || myLost)
+    return 0;
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void SerialPortMACOS::setTimeout(uInt32 timeout_milliseconds)
-{
-  mySerialTimeoutCount = timeout_milliseconds / 100;
+  struct iovec iov[MAX_SEGMENTS];
+  count = std::min(count, MAX_SEGMENTS);
+  for(uInt32 i = 0; i < count; ++i)
+  {
+    iov[i].iov_base = const_cast<void*>(segments[i].data);
+    iov[i].iov_len  = segments[i].size;
+  }
+
+  // Reads rely on VTIME, so the port is left blocking; it is made
+  // non-blocking just for the write, so that waiting for room (when the
+  // buffer is full, or output is held by flow control) never goes past
+  // the current deadline
+  int flags = fcntl(myHandle, F_GETFL);
+  fcntl(myHandle, F_SETFL, flags | O_NONBLOCK);
+
+  uInt32 result = 0;
+  struct pollfd pfd;
+  pfd.fd = myHandle;
+  pfd.events = POLLOUT;
+  for(;;)
+  {
+    pfd.revents = 0;
+    int ready = poll(&pfd, 1, int((timeRemaining() + 999) / 1000));
+    if(ready < 0 && errno == EINTR)
+      continue;
+    else if(ready <= 0)
+      break;
+    else if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+    {
+      myLost = true;
+      break;
+    }
+
+    ssize_t n = writev(myHandle, iov, int(count));
+    if(n > 0)
+    {
+      result = uInt32(n);
+      break;
+    }
+    else if(n < 0 && (errno == EIO || errno == ENXIO || errno == ENODEV))
+    {
+      myLost = true;  // The device has been unplugged
+      break;
+    }
+    else if((n < 0 && errno != EAGAIN && errno != EINTR) || timeoutCheck())
+      break;
+  }
+
+  fcntl(myHandle, F_SETFL, flags);
+  return result;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
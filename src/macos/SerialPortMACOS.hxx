@@ -61,9 +61,9 @@ class SerialPortMACOS : public SerialPort
 
     /**
       Receives a buffer from the open com port. Returns all the characters
-      ready (waits for up to 'n' milliseconds before accepting that no more
-      characters are ready) or when the buffer is full. 'n' is system dependent,
-      see SerialTimeout routines.
+      ready (waits for up to 100 milliseconds before accepting that no more
+      characters are ready) or when the buffer is full.  The callers in
+      SerialPort repeat this until the deadline set by setTimeout() passes.
 
       @param answer    Buffer to hold the bytes read from the serial port
       @param max_size  The size of buffer pointed to by answer
@@ -72,25 +72,15 @@ class SerialPortMACOS : public SerialPort
     uInt32 receiveBlock(void* answer, uInt32 max_size) override;
 
     /**
-      Write block of bytes to the serial port.
+      Write as many of the given segments as the port will accept in one
+      go (with a single writev), waiting no longer than the deadline set
+      by setTimeout() for it to accept anything at all.
 
-      @param data  The byte(s) to write to the port
-      @param size  The size of the block
+      @param segments  The data to write
+      @param count     The number of segments
       @return  The number of bytes written
     */
-    uInt32 sendBlock(const void* data, uInt32 size) override;
-
-    /**
-      Sets (or resets) the timeout to the timout period requested.  Starts
-      counting to this period.  This timeout support is a little odd in that
-      the timeout specifies the accumulated deadtime waiting to read not the
-      total time waiting to read. They should be close enough to the same for
-      this use. Used by the serial input routines, the actual counting takes
-      place in receiveBlock.
-
-      @param timeout_milliseconds  The time in milliseconds to use for timeout
-    */
-    void setTimeout(uInt32 timeout_milliseconds) override;
+    uInt32 sendVector(const Segment* segments, uInt32 count) override;
 
     /**
       Empty the serial port buffers.  Cleans things to a known state.
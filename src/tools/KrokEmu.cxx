@@ -0,0 +1,292 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "KrokEmu.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+KrokEmu::KrokEmu()
+  : myFlash{make_unique<uInt8[]>(EMU_FLASH_SIZE)}
+{
+  // Erased flash reads back as all ones
+  memset(myFlash.get(), 0xff, EMU_FLASH_SIZE);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+KrokEmu::~KrokEmu()
+{
+  stop();
+  if(mySlave >= 0)   close(mySlave);
+  if(myMaster >= 0)  close(myMaster);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool KrokEmu::open()
+{
+  myMaster = posix_openpt(O_RDWR | O_NOCTTY);
+  if(myMaster < 0 || grantpt(myMaster) != 0 || unlockpt(myMaster) != 0)
+    return false;
+
+  const char* name = ptsname(myMaster);
+  if(name == nullptr)
+    return false;
+  myPortName = name;
+
+  // Keep the slave side open ourselves, so the host can open and close
+  // the port as often as it likes without the master seeing a hangup
+  mySlave = ::open(name, O_RDWR | O_NOCTTY);
+  if(mySlave < 0)
+    return false;
+
+  struct termios tio;
+  tcgetattr(mySlave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(mySlave, TCSANOW, &tio);
+
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokEmu::start()
+{
+  stop();
+  myRunning = true;
+  myThread = std::thread([this]() { processCommands(); });
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokEmu::stop()
+{
+  myRunning = false;
+  if(myThread.joinable())
+    myThread.join();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokEmu::run()
+{
+  myRunning = true;
+  processCommands();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokEmu::processCommands()
+{
+  while(myRunning)
+  {
+    // Every command starts with a '1'; anything else is line noise
+    uInt8 command[2];
+    if(!receive(command, 1, 250) || command[0] != 1)
+      continue;
+    if(!receive(command+1, 1, 100))
+      continue;
+
+    switch(command[1])
+    {
+      case 0:  downloadSector();  break;
+      case 1:  readSector();      break;
+      case 2:  sendVersion();     break;
+      default:                    break;
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokEmu::downloadSector()
+{
+  // Sector # (hi, lo), bankswitch type, 256 data bytes, checksum
+  uInt8 frame[260];
+  if(!receive(frame, 260, 1000))
+    return;
+
+  uInt8 chksum = 0;
+  for(int i = 0; i < 259; ++i)
+    chksum ^= frame[i];
+
+  uInt32 sector = (frame[0] << 8) | frame[1];
+  uInt8 result = 0xff;
+  ++myDownloads;
+  if(chksum != frame[259] || sector >= EMU_FLASH_SIZE/256 ||
+     (myNakInterval > 0 && myDownloads % myNakInterval == 0))
+  {
+    result = 0x7c;
+    ++myNaksSent;
+  }
+  else
+  {
+    memcpy(myFlash.get() + sector*256, frame + 3, 256);
+    ++mySectorsWritten;
+
+    // A flash cell that didn't take the write; the cart can't tell
+    if(myCorruptInterval > 0 && myDownloads % myCorruptInterval == 0)
+    {
+      myFlash.get()[sector*256 + myDownloads % 256] ^= 0x01;
+      ++mySectorsCorrupted;
+    }
+  }
+
+  if(myDropInterval > 0 && myDownloads % myDropInterval == 0)
+  {
+    ++myRepliesDropped;
+    return;
+  }
+
+  reply(&result, 1, 262);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokEmu::readSector()
+{
+  // Sector # (hi, lo), checksum
+  uInt8 frame[3];
+  if(!receive(frame, 3, 100))
+    return;
+
+  uInt32 sector = (frame[0] << 8) | frame[1];
+  if((frame[0] ^ frame[1]) != frame[2] || sector >= EMU_FLASH_SIZE/256)
+  {
+    uInt8 result = 0x00;
+    reply(&result, 1, 5);
+    return;
+  }
+
+  uInt8 buffer[258];
+  buffer[0] = 0xfe;
+  memcpy(buffer + 1, myFlash.get() + sector*256, 256);
+  uInt8 chksum = 0;
+  for(int i = 1; i < 257; ++i)
+    chksum ^= buffer[i];
+  buffer[257] = chksum;
+
+  ++mySectorsRead;
+  ++myReads;
+  if(myStallInterval > 0 && myReads % myStallInterval == 0)
+  {
+    ++myReadsStalled;
+    busy(EMU_STALL_TIME * 1000);
+  }
+  reply(buffer, 258, 5);
+
+  // The host acknowledges the data with a single (arbitrary) byte
+  uInt8 ack;
+  receive(&ack, 1, 250);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokEmu::sendVersion()
+{
+  string buffer = "\xff" + myVersion;
+  reply(reinterpret_cast<const uInt8*>(buffer.c_str()), uInt32(buffer.size()) + 1, 2);
+
+  // The host acknowledges a valid version string with a single byte
+  uInt8 ack;
+  receive(&ack, 1, 250);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool KrokEmu::receive(uInt8* data, uInt32 size, uInt32 timeout)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+  uInt32 count = 0;
+  while(count < size && myRunning)
+  {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now()).count();
+    if(remaining <= 0)
+      break;
+
+    // Wake up regularly, so stop() is noticed, and when a reply is due
+    Int64 wait = std::min<Int64>(remaining, 50);
+    Int64 due = deliverReplies();
+    if(due >= 0)
+      wait = std::min(wait, (due + 999) / 1000);  // round up, so it's due by then
+    struct pollfd pfd = { myMaster, POLLIN, 0 };
+    if(poll(&pfd, 1, int(wait)) <= 0)
+      continue;
+
+    ssize_t bytes = read(myMaster, data + count, size - count);
+    if(bytes > 0)
+      count += uInt32(bytes);
+  }
+  return count == size;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokEmu::reply(const uInt8* data, uInt32 size, uInt32 receivedBytes)
+{
+  uInt64 delay = uInt64(receivedBytes + size) * myByteLatency / 1000 + myCommandLatency;
+  busy(delay);
+
+  if(myTurnaroundLatency == 0 && myReplies.empty())
+    write(data, size);
+  else
+  {
+    myReplies.push_back({ std::chrono::steady_clock::now() +
+                          std::chrono::microseconds(myTurnaroundLatency),
+                          string(reinterpret_cast<const char*>(data), size) });
+    deliverReplies();
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+Int64 KrokEmu::deliverReplies()
+{
+  auto now = std::chrono::steady_clock::now();
+  while(!myReplies.empty() && myReplies.front().due <= now)
+  {
+    const string& data = myReplies.front().data;
+    write(reinterpret_cast<const uInt8*>(data.data()), uInt32(data.size()));
+    myReplies.pop_front();
+  }
+  if(myReplies.empty())
+    return -1;
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      myReplies.front().due - now).count() + 1;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokEmu::busy(uInt64 usec)
+{
+  auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(usec);
+  for(;;)
+  {
+    auto left = until - std::chrono::steady_clock::now();
+    Int64 due = deliverReplies();
+    if(left <= std::chrono::steady_clock::duration::zero())
+      break;
+    if(due >= 0)
+      left = std::min<std::chrono::steady_clock::duration>(left, std::chrono::microseconds(due));
+    std::this_thread::sleep_for(left);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void KrokEmu::write(const uInt8* data, uInt32 size)
+{
+  uInt32 count = 0;
+  while(count < size)
+  {
+    ssize_t bytes = ::write(myMaster, data + count, size - count);
+    if(bytes > 0)
+      count += uInt32(bytes);
+    else if(bytes < 0 && errno != EAGAIN && errno != EINTR)
+      break;
+  }
+}
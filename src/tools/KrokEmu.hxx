@@ -0,0 +1,189 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef KROK_EMU_HXX
+#define KROK_EMU_HXX
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <thread>
+
+#include "bspf.hxx"
+
+// 2048 sectors of 256 bytes each, as in a real KrokCart
+#define EMU_FLASH_SIZE 2048*256
+
+// Time (in milliseconds) a stalled sector read is held up; well past the
+// time the host waits for a reply once it has timed the link
+#define EMU_STALL_TIME 300
+
+/**
+  This class emulates a KrokCart on a pseudo-terminal, so that the
+  serial code can be run (and timed) without real hardware attached.
+  It speaks the same protocol as the cart firmware:
+
+    1,2                     version info; replies with an ack byte and a
+                            NUL-terminated version string, then expects
+                            a single ack byte
+    1,0,hi,lo,type,data,chk download a 256 byte sector; replies 0xFF, or
+                            0x7C if the checksum is bad
+    1,1,hi,lo,chk           read a sector; replies 0xFE (or 0x00 if the
+                            checksum is bad) followed by the 256 data bytes
+                            and their checksum, then expects a single
+                            ack byte
+
+  The time taken to move each byte over the wire, and for the cart to
+  act on each command, can be set to mimic a real cart and link.  So can
+  the turnaround time for a reply to reach the host (USB polling, serial
+  adapter buffering); the cart goes on to the next command meanwhile, so
+  this is the part of each round trip that a window of sectors can hide.
+
+  @author  Stephen Anthony
+*/
+class KrokEmu
+{
+  public:
+    KrokEmu();
+    ~KrokEmu();
+
+    /**
+      Create the pseudo-terminal; the host should then open portName().
+
+      @return  False if the pseudo-terminal couldn't be created, else true
+    */
+    bool open();
+
+    /** The name of the device the host should open. */
+    const string& portName() const { return myPortName; }
+
+    /**
+      Process commands, either in a separate thread (start/stop)
+      or in the calling thread (run, until stop is called).
+    */
+    void start();
+    void stop();
+    void run();
+
+    /** Time (in nanoseconds) taken to move one byte in either direction. */
+    void setByteLatency(uInt32 nsec) { myByteLatency = nsec; }
+
+    /** Time (in microseconds) taken by the cart to act on each command. */
+    void setCommandLatency(uInt32 usec) { myCommandLatency = usec; }
+
+    /** Time (in microseconds) taken for each reply to reach the host. */
+    void setTurnaroundLatency(uInt32 usec) { myTurnaroundLatency = usec; }
+
+    /** Reply to every n'th sector download with a checksum error (0 = never). */
+    void setNakInterval(uInt32 n) { myNakInterval = n; }
+
+    /** Write every n'th sector download, but lose the reply (0 = never). */
+    void setDropInterval(uInt32 n) { myDropInterval = n; }
+
+    /** Acknowledge every n'th sector download, but store it damaged (0 = never). */
+    void setCorruptInterval(uInt32 n) { myCorruptInterval = n; }
+
+    /** Hold up the reply to every n'th sector read by EMU_STALL_TIME (0 = never). */
+    void setStallInterval(uInt32 n) { myStallInterval = n; }
+
+    /** The version string reported to the host. */
+    void setVersion(const string& version) { myVersion = version; }
+
+    /** The contents of the emulated flash memory. */
+    const uInt8* flash() const { return myFlash.get(); }
+
+    /** Statistics for all commands processed so far. */
+    uInt32 sectorsWritten() const { return mySectorsWritten; }
+    uInt32 sectorsRead() const    { return mySectorsRead;    }
+    uInt32 naksSent() const       { return myNaksSent;       }
+    uInt32 repliesDropped() const { return myRepliesDropped; }
+    uInt32 sectorsCorrupted() const { return mySectorsCorrupted; }
+    uInt32 readsStalled() const   { return myReadsStalled;   }
+
+  private:
+    /**
+      Read exactly 'size' bytes from the host, waiting up to 'timeout'
+      milliseconds in total.
+
+      @return  False on timeout or when asked to stop, else true
+    */
+    bool receive(uInt8* data, uInt32 size, uInt32 timeout);
+
+    /**
+      Send data to the host, after waiting for the time it would take
+      the given number of bytes to cross the link and for the command
+      to be processed.  With a turnaround time, the reply is only queued,
+      and delivered by deliverReplies() once that time has passed.
+    */
+    void reply(const uInt8* data, uInt32 size, uInt32 receivedBytes);
+
+    /**
+      Send the queued replies whose turnaround time has passed.
+
+      @return  Time (in microseconds) until the next one is due, or -1
+               when none are queued
+    */
+    Int64 deliverReplies();
+
+    /**
+      Spend the given time (in microseconds) acting on a command; replies
+      already on their way still reach the host meanwhile.
+    */
+    void busy(uInt64 usec);
+
+    /** Write all the given data to the host. */
+    void write(const uInt8* data, uInt32 size);
+
+    void processCommands();
+    void downloadSector();
+    void readSector();
+    void sendVersion();
+
+  private:
+    int myMaster{-1};
+    int mySlave{-1};
+    string myPortName;
+
+    ByteBuffer myFlash;
+    string myVersion{"KrokEmu v1.0 (pseudo-terminal)"};
+
+    uInt32 myByteLatency{0};
+    uInt32 myCommandLatency{0};
+    uInt32 myTurnaroundLatency{0};
+    uInt32 myNakInterval{0};
+    uInt32 myDropInterval{0};
+    uInt32 myCorruptInterval{0};
+    uInt32 myStallInterval{0};
+
+    // Replies still on their way to the host, oldest first
+    struct Reply {
+      std::chrono::steady_clock::time_point due;
+      string data;
+    };
+    std::deque<Reply> myReplies;
+
+    std::thread myThread;
+    std::atomic<bool> myRunning{false};
+
+    std::atomic<uInt32> mySectorsWritten{0};
+    std::atomic<uInt32> mySectorsRead{0};
+    std::atomic<uInt32> myNaksSent{0};
+    std::atomic<uInt32> myRepliesDropped{0};
+    std::atomic<uInt32> mySectorsCorrupted{0};
+    std::atomic<uInt32> myReadsStalled{0};
+    uInt32 myDownloads{0};
+    uInt32 myReads{0};
+};
+
+#endif // KROK_EMU_HXX
@@ -0,0 +1,307 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+#include "bspf.hxx"
+#include "Cart.hxx"
+#include "KrokEmu.hxx"
+#include "SerialPortUNIX.hxx"
+
+using Clock = std::chrono::steady_clock;
+
+// The images that are timed; each is filled with (repeatable) random data
+struct BenchCase {
+  const char* name;
+  const char* type;
+  uInt32 size;
+};
+static constexpr BenchCase ourCases[] = {
+  { "4K",   "4K", 4_KB   },
+  { "32K",  "F4", 32_KB  },
+  { "3F",   "3F", 64_KB  },
+  { "512K", "3F", 512_KB }
+};
+
+// The emulated KrokCart takes this long to act on each command, unless
+// told otherwise (a rough figure for programming a sector of flash)
+static constexpr uInt32 DEFAULT_CMD_LATENCY = 1000;
+
+// Results of a single download or verify pass
+struct PassResult {
+  vector<double> latency;  // time taken by each call, in microseconds
+  double seconds{0};
+  uInt32 retries{0};
+  bool success{true};
+  string error;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static PassResult runPass(Cart& cart, SerialPort& port, bool download,
+                          bool faultFree)
+{
+  PassResult result;
+  uInt16 numSectors = cart.initSectors(download);
+  result.latency.reserve(numSectors);
+
+  auto start = Clock::now();
+  try
+  {
+    for(uInt16 sector = 0; sector < numSectors; ++sector)
+    {
+      auto t0 = Clock::now();
+      if(download)
+        cart.writeNextSector(port);
+      else
+        cart.verifyNextSector(port);
+      result.latency.push_back(
+          std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+    }
+  }
+  catch(const char* msg)
+  {
+    result.success = false;
+    result.error = msg;
+  }
+  if(download && !cart.finalizeSectors())
+    result.success = false;
+
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  result.retries = cart.stats().retries();
+
+  // Over a link that loses nothing, a retry means the host got it wrong
+  if(faultFree && result.retries > 0 && result.success)
+  {
+    result.success = false;
+    result.error = "retried on an emulated link without faults";
+  }
+  return result;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static double percentile(const vector<double>& sorted, double p)
+{
+  if(sorted.empty())
+    return 0;
+  size_t index = size_t(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static void report(ostream& out, const char* image, const char* pass,
+                   const vector<PassResult>& runs)
+{
+  vector<double> latency;
+  double seconds = 0;
+  uInt32 sectors = 0, retries = 0, failures = 0;
+  for(const auto& run: runs)
+  {
+    latency.insert(latency.end(), run.latency.begin(), run.latency.end());
+    seconds += run.seconds;
+    sectors += uInt32(run.latency.size());
+    retries += run.retries;
+    if(!run.success)  ++failures;
+  }
+  std::sort(latency.begin(), latency.end());
+
+  double rate = seconds > 0 ? sectors / seconds : 0;
+  out << std::left << std::setw(6) << image << std::setw(9) << pass << std::right
+      << std::fixed << std::setprecision(0)
+      << std::setw(8) << sectors
+      << std::setw(10) << rate
+      << std::setw(9) << rate / 4  // 256 byte sectors
+      << std::setw(9) << percentile(latency, 50)
+      << std::setw(9) << percentile(latency, 90)
+      << std::setw(9) << percentile(latency, 99)
+      << std::setw(9) << (latency.empty() ? 0 : latency.back())
+      << std::setw(8) << retries
+      << std::setw(7) << failures << std::endl;
+
+  for(const auto& run: runs)
+    if(run.error != "")
+    {
+      out << "        " << run.error.c_str() << std::endl;
+      break;
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int main(int ac, char* av[])
+{
+  KrokEmu emu;
+  string device = "";
+  uInt32 runs = 3, window = 1, retry = 3, baud = 115200;
+  uInt32 cmdLatency = DEFAULT_CMD_LATENCY, turnLatency = 0;
+  uInt32 nak = 0, drop = 0, corrupt = 0, stall = 0;
+  Int32 byteLatency = -1;  // worked out from the baud rate, unless given
+  bool verify = true, verifyWrites = false;
+
+  for(int i = 1; i < ac; ++i)
+  {
+    if(strstr(av[i], "-runs=") == av[i])
+      runs = std::max(BSPF::stoi(av[i]+6, 1), 1);
+    else if(strstr(av[i], "-window=") == av[i])
+      window = BSPF::stoi(av[i]+8, 1);
+    else if(strstr(av[i], "-retry=") == av[i])
+      retry = BSPF::stoi(av[i]+7, 3);
+    else if(strstr(av[i], "-baud=") == av[i])
+      baud = BSPF::stoi(av[i]+6, 115200);
+    else if(strstr(av[i], "-byte=") == av[i])
+      byteLatency = std::max(BSPF::stoi(av[i]+6, 0), 0);
+    else if(strstr(av[i], "-cmd=") == av[i])
+      cmdLatency = std::max(BSPF::stoi(av[i]+5, 0), 0);
+    else if(strstr(av[i], "-turn=") == av[i])
+      turnLatency = std::max(BSPF::stoi(av[i]+6, 0), 0);
+    else if(strstr(av[i], "-nak=") == av[i])
+      emu.setNakInterval(nak = BSPF::stoi(av[i]+5, 0));
+    else if(strstr(av[i], "-drop=") == av[i])
+      emu.setDropInterval(drop = BSPF::stoi(av[i]+6, 0));
+    else if(strstr(av[i], "-corrupt=") == av[i])
+      emu.setCorruptInterval(corrupt = BSPF::stoi(av[i]+9, 0));
+    else if(strstr(av[i], "-stall=") == av[i])
+      emu.setStallInterval(stall = BSPF::stoi(av[i]+7, 0));
+    else if(strstr(av[i], "-port=") == av[i])
+      device = av[i]+6;
+    else if(!strcmp(av[i], "-noverify"))
+      verify = false;
+    else if(!strcmp(av[i], "-vw"))
+      verifyWrites = true;
+    else
+    {
+      cout << "Usage: krokbench [options ...]" << std::endl
+           << "       Time complete downloads and verifies of several image sizes" << std::endl
+           << std::endl
+           << "Valid options are:" << std::endl
+           << std::endl
+           << "  -runs=[n]    Number of times each image is transferred (default is 3)" << std::endl
+           << "  -window=[n]  Sectors sent before waiting for an acknowledgement (default is 1)" << std::endl
+           << "  -retry=[n]   Retries allowed for each sector (default is 3)" << std::endl
+           << "  -noverify    Only time downloads" << std::endl
+           << "  -vw          Read back each sector as it is downloaded (implies -noverify)" << std::endl
+           << "  -port=[dev]  Use the KrokCart on the given device instead of the emulator" << std::endl
+           << std::endl
+           << "Options for the built-in emulator:" << std::endl
+           << std::endl
+           << "  -baud=[n]    Move data as slowly as a serial link at the given rate (default is 115200)" << std::endl
+           << "  -byte=[ns]   Time taken to move each byte, in nanoseconds (overrides -baud)" << std::endl
+           << "  -cmd=[us]    Time taken to act on each command, in microseconds (default is "
+           << DEFAULT_CMD_LATENCY << ")" << std::endl
+           << "  -turn=[us]   Time taken for each reply to reach the host, in microseconds;" << std::endl
+           << "               the next command is acted on meanwhile (default is 0)" << std::endl
+           << "  -nak=[n]     Reject every n'th sector download with a checksum error" << std::endl
+           << "  -drop=[n]    Lose the reply to every n'th sector download" << std::endl
+           << "  -corrupt=[n] Store every n'th sector download damaged (but acknowledge it)" << std::endl
+           << "  -stall=[n]   Hold up the reply to every n'th sector read for "
+           << EMU_STALL_TIME << " ms" << std::endl
+           << std::endl;
+      return 1;
+    }
+  }
+  // Each sector has already been read back when writes are verified
+  if(verifyWrites)
+    verify = false;
+
+  // The emulated link moves 10 bits per byte (start, 8 data, stop)
+  if(byteLatency < 0)
+    byteLatency = baud > 0 ? Int32(10000000000ULL / baud) : 0;
+  emu.setByteLatency(uInt32(byteLatency));
+  emu.setCommandLatency(cmdLatency);
+  emu.setTurnaroundLatency(turnLatency);
+
+  // Without a real cart, run the emulator in its own thread
+  bool emulated = device == "";
+  if(emulated)
+  {
+    if(!emu.open())
+    {
+      cout << "ERROR: couldn't create pseudo-terminal" << std::endl;
+      return 1;
+    }
+    emu.start();
+    device = emu.portName();
+  }
+  bool faultFree = emulated && nak + drop + corrupt + stall == 0;
+
+  SerialPortUNIX port;
+  port.setBaud(baud);
+  port.setControlSwap(false);
+  if(!port.openPort(device))
+  {
+    cout << "ERROR: couldn't open \'" << device.c_str() << "\'" << std::endl;
+    return 1;
+  }
+
+  // Cart reports its progress on cout; keep that out of the results
+  ostream out(cout.rdbuf());
+  std::ostringstream discard;
+
+  out << "Device: \'" << device.c_str() << "\', " << runs << " runs, window "
+      << window << ", " << retry << " retries" << std::endl;
+  if(emulated)
+    out << "Emulated link: " << byteLatency << " ns/byte, " << cmdLatency
+        << " us/command, " << turnLatency << " us turnaround" << std::endl;
+  if(window > 1)
+    out << "Latencies are per call: with a window, most calls only queue a sector,"
+        << std::endl << "and one call then waits for the whole window" << std::endl;
+  out << std::endl
+      << "Image Pass      Sectors Sectors/s    KB/s  p50(us)  p90(us)  p99(us)  max(us) Retries Failed"
+      << std::endl;
+
+  std::mt19937 random(2009);
+  auto romfile = std::filesystem::temp_directory_path() / "krokbench.bin";
+  for(const auto& bench: ourCases)
+  {
+    // Create the image
+    vector<char> image(bench.size);
+    for(auto& byte: image)
+      byte = char(random());
+    {
+      std::ofstream rom(romfile, std::ios::binary);
+      rom.write(image.data(), image.size());
+    }
+
+    auto cart = make_unique<Cart>();
+    cout.rdbuf(discard.rdbuf());
+    cart->create(romfile.string(), bench.type);
+    cart->setWindow(window);
+    cart->setRetry(retry);
+    cart->setVerifyWrites(verifyWrites);
+
+    vector<PassResult> downloads, verifies;
+    for(uInt32 run = 0; run < runs; ++run)
+    {
+      downloads.push_back(runPass(*cart, port, true, faultFree));
+      if(verify)
+      {
+        // It seems we must wait a while before attempting a verify
+        port.sleepMillis(100);
+        verifies.push_back(runPass(*cart, port, false, faultFree));
+      }
+      discard.str("");
+    }
+    cout.rdbuf(out.rdbuf());
+
+    report(out, bench.name, "download", downloads);
+    if(verify)
+      report(out, bench.name, "verify", verifies);
+  }
+  std::filesystem::remove(romfile);
+
+  port.closePort();
+  emu.stop();
+  return 0;
+}
@@ -0,0 +1,69 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <cstdlib>
+#include <cstring>
+
+#include "bspf.hxx"
+#include "Cart.hxx"
+#include "CartDetector.hxx"
+#include "CommandLine.hxx"
+#include "KrokDaemon.hxx"
+#include "SerialPortManager.hxx"
+#include "Settings.hxx"
+
+/**
+  The commandline half of krokcom, without Qt.  It starts about as fast
+  as the process itself, and needs no display, so it suits flashing
+  machines without one and tight build scripts.  Settings are kept in a
+  plain text file instead of with QSettings.
+*/
+int main(int ac, char* av[])
+{
+  if(ac == 1 || (ac == 2 && !strcmp(av[1], "-help")))
+  {
+    CommandLine::usage("krokcli", false);
+    return 0;
+  }
+
+  if(strstr(av[1], "-remote") == av[1])
+    return CommandLine::remote(av[1][7] == '=' ? string(av[1]+8) : KrokDaemon::defaultSocketPath(),
+                               ac - 2, av + 2);
+
+  // Use the same files as the GUI, in the users' home directory
+  const char* home = getenv("HOME");
+  string dir = string(home ? home : ".") + "/";
+  Cart::setManifestFilePath(dir + ".KCMANIFEST.bin");
+  Cart::setJournalFilePath(dir + ".KCJOURNAL.txt");
+  CartDetector::setRomInfoFilePath(dir + ".KCROMTYPES.bin");
+
+  // The port where a KrokCart was found last time is tried first
+  SerialPortManager manager;
+  manager.setDefaultPort(Settings::value("MainWindow", "krokport"),
+                         BSPF::stoi(Settings::value("MainWindow", "krokbaud"), 0));
+
+  int status = 0;
+  if(ac == 2 && strstr(av[1], "-daemon") == av[1])
+    status = CommandLine::daemon(manager,
+        av[1][7] == '=' ? string(av[1]+8) : KrokDaemon::defaultSocketPath());
+  else
+    status = CommandLine::run(manager, ac, av) ? 0 : 1;
+
+  if(manager.krokCartAvailable())
+  {
+    Settings::setValue("MainWindow", "krokport", manager.portName());
+    Settings::setValue("MainWindow", "krokbaud", std::to_string(manager.baudRate()));
+  }
+  return status;
+}
@@ -0,0 +1,124 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+
+#include "bspf.hxx"
+#include "KrokEmu.hxx"
+
+static KrokEmu* ourEmu = nullptr;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static void handleSignal(int)
+{
+  if(ourEmu)
+    ourEmu->stop();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int main(int ac, char* av[])
+{
+  KrokEmu emu;
+  string link = "", dump = "";
+
+  for(int i = 1; i < ac; ++i)
+  {
+    if(strstr(av[i], "-baud=") == av[i])
+    {
+      // 10 bits per byte (start, 8 data, stop)
+      uInt32 baud = BSPF::stoi(av[i]+6, 0);
+      if(baud > 0)
+        emu.setByteLatency(uInt32(10000000000ULL / baud));
+    }
+    else if(strstr(av[i], "-byte=") == av[i])
+      emu.setByteLatency(BSPF::stoi(av[i]+6, 0));
+    else if(strstr(av[i], "-cmd=") == av[i])
+      emu.setCommandLatency(BSPF::stoi(av[i]+5, 0));
+    else if(strstr(av[i], "-turn=") == av[i])
+      emu.setTurnaroundLatency(BSPF::stoi(av[i]+6, 0));
+    else if(strstr(av[i], "-nak=") == av[i])
+      emu.setNakInterval(BSPF::stoi(av[i]+5, 0));
+    else if(strstr(av[i], "-drop=") == av[i])
+      emu.setDropInterval(BSPF::stoi(av[i]+6, 0));
+    else if(strstr(av[i], "-corrupt=") == av[i])
+      emu.setCorruptInterval(BSPF::stoi(av[i]+9, 0));
+    else if(strstr(av[i], "-stall=") == av[i])
+      emu.setStallInterval(BSPF::stoi(av[i]+7, 0));
+    else if(strstr(av[i], "-version=") == av[i])
+      emu.setVersion(av[i]+9);
+    else if(strstr(av[i], "-link=") == av[i])
+      link = av[i]+6;
+    else if(strstr(av[i], "-dump=") == av[i])
+      dump = av[i]+6;
+    else
+    {
+      cout << "Usage: krokemu [options ...]" << std::endl
+           << "       Emulate a KrokCart on a pseudo-terminal, until interrupted" << std::endl
+           << std::endl
+           << "Valid options are:" << std::endl
+           << std::endl
+           << "  -baud=[n]      Move data as slowly as a serial link at the given rate" << std::endl
+           << "  -byte=[ns]     Time taken to move each byte, in nanoseconds" << std::endl
+           << "  -cmd=[us]      Time taken to act on each command, in microseconds" << std::endl
+           << "  -turn=[us]     Time taken for each reply to reach the host, in microseconds" << std::endl
+           << "  -nak=[n]       Reject every n'th sector download with a checksum error" << std::endl
+           << "  -drop=[n]      Lose the reply to every n'th sector download" << std::endl
+           << "  -corrupt=[n]   Store every n'th sector download damaged (but acknowledge it)" << std::endl
+           << "  -stall=[n]     Hold up the reply to every n'th sector read for "
+           << EMU_STALL_TIME << " ms" << std::endl
+           << "  -version=[id]  Version string to report to the host" << std::endl
+           << "  -link=[path]   Create a symlink to the port at the given path" << std::endl
+           << "  -dump=[file]   Save the contents of the flash to the given file on exit" << std::endl
+           << std::endl;
+      return 1;
+    }
+  }
+
+  if(!emu.open())
+  {
+    cout << "ERROR: couldn't create pseudo-terminal" << std::endl;
+    return 1;
+  }
+  if(link != "")
+  {
+    unlink(link.c_str());
+    if(symlink(emu.portName().c_str(), link.c_str()) != 0)
+      cout << "WARNING: couldn't create link \'" << link.c_str() << "\'" << std::endl;
+  }
+  cout << "KrokEmu listening on \'" << emu.portName().c_str() << "\'" << std::endl;
+
+  ourEmu = &emu;
+  signal(SIGINT, handleSignal);
+  signal(SIGTERM, handleSignal);
+  emu.run();
+
+  cout << std::endl << "Sectors written: " << emu.sectorsWritten()
+       << ", read: " << emu.sectorsRead()
+       << ", rejected: " << emu.naksSent()
+       << ", replies lost: " << emu.repliesDropped()
+       << ", damaged: " << emu.sectorsCorrupted()
+       << ", reads held up: " << emu.readsStalled() << std::endl;
+
+  if(dump != "")
+  {
+    std::ofstream out(dump, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(emu.flash()), EMU_FLASH_SIZE);
+  }
+  if(link != "")
+    unlink(link.c_str());
+
+  return 0;
+}
@@ -26,10 +26,15 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/param.h>
+#include <sys/uio.h>
+#include <poll.h>
 #include <dirent.h>
+#include <climits>
+#include <cstdlib>
 #include <cstring>
 
 #include "SerialPortUNIX.hxx"
+#include "Termios2.hxx"
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 SerialPortUNIX::SerialPortUNIX()
@@ -46,19 +51,22 @@ SerialPortUNIX::~SerialPortUNIX()
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool SerialPortUNIX::openPort(const string& device)
 {
+  myLost = false;
   myHandle = open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
   if(myHandle < 0)
     return false;
 
-  // clear input & output buffers, then switch to "blocking mode"
+  // clear input & output buffers
+  // The port stays in non-blocking mode; all reads and writes first wait
+  // with poll(), so they can never block past their deadline
   tcflush(myHandle, TCOFLUSH);
   tcflush(myHandle, TCIFLUSH);
-  fcntl(myHandle, F_SETFL, fcntl(myHandle, F_GETFL) & ~O_NONBLOCK);
 
   tcgetattr(myHandle, &myOldtio); // save current port settings
 
   memset(&myNewtio, 0, sizeof(struct termios));
   myNewtio.c_cflag = CS8 | CLOCAL | CREAD;
+  bool customBaud = false;
 
 #if defined(__FreeBSD__) || defined(__OpenBSD__)
   if(cfsetspeed(&myNewtio, (speed_t)myBaud)
@@ -74,9 +82,21 @@ bool SerialPortUNIX::openPort(const string& device)
 #if defined (B1152000)
     case 1152000: NEWTERMIOS_SETBAUDRATE(B1152000); break;
 #endif
+#if defined (B1000000)
+    case 1000000: NEWTERMIOS_SETBAUDRATE(B1000000); break;
+#endif
+#if defined (B921600)
+    case  921600: NEWTERMIOS_SETBAUDRATE(B921600);  break;
+#endif
 #if defined (B576000)
     case  576000: NEWTERMIOS_SETBAUDRATE(B576000);  break;
 #endif
+#if defined (B500000)
+    case  500000: NEWTERMIOS_SETBAUDRATE(B500000);  break;
+#endif
+#if defined (B460800)
+    case  460800: NEWTERMIOS_SETBAUDRATE(B460800);  break;
+#endif
 #if defined (B230400)
     case  230400: NEWTERMIOS_SETBAUDRATE(B230400);  break;
 #endif
@@ -87,8 +107,15 @@ bool SerialPortUNIX::openPort(const string& device)
     case    9600: NEWTERMIOS_SETBAUDRATE(B9600);    break;
     default:
     {
+  #if defined(__linux__)
+      // Any other rate is set through termios2 once the port is configured
+      NEWTERMIOS_SETBAUDRATE(B38400);
+      customBaud = true;
+      break;
+  #else
       cerr << "ERROR: unknown baudrate " << myBaud << std::endl;
       return false;
+  #endif
     }
   }
 #endif
@@ -100,8 +127,8 @@ bool SerialPortUNIX::openPort(const string& device)
   myNewtio.c_lflag = 0;
 
   cfmakeraw(&myNewtio);
-  myNewtio.c_cc[VTIME] = 1;   /* inter-character timer used */
-  myNewtio.c_cc[VMIN]  = 0;   /* blocking read until 0 chars received */
+  myNewtio.c_cc[VTIME] = 0;   /* no inter-character timer; poll() waits */
+  myNewtio.c_cc[VMIN]  = 0;   /* read returns whatever is available */
 
   tcflush(myHandle, TCIFLUSH);
   if(tcsetattr(myHandle, TCSANOW, &myNewtio))
@@ -109,6 +136,12 @@ bool SerialPortUNIX::openPort(const string& device)
     cerr << "Could not change serial port behaviour (wrong baudrate?)\n";
     return false;
   }
+  if(customBaud && !setTermios2Baud(myHandle, myBaud))
+  {
+    cerr << "ERROR: baudrate " << myBaud << " not supported by " << device << std::endl;
+    closePort();
+    return false;
+  }
 
   return true;
 }
@@ -136,26 +169,83 @@ bool SerialPortUNIX::isOpen()
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 uInt32 SerialPortUNIX::receiveBlock(void* answer, uInt32 max_size)
 {
-  uInt32 result = 0;
-  if(myHandle)
+  if(!myHandle || myLost)
+    return 0;
+
+  // Wait for data to arrive, but never past the current deadline
+  Int64 usec = timeRemaining();
+  struct pollfd pfd;
+  pfd.fd = myHandle;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+#if defined(__linux__)
+  struct timespec ts;
+  ts.tv_sec  = usec / 1000000;
+  ts.tv_nsec = (usec % 1000000) * 1000;
+  int ready = ppoll(&pfd, 1, &ts, NULL);
+#else
+  int ready = poll(&pfd, 1, int((usec + 999) / 1000));
+#endif
+  if(ready <= 0)
+    return 0;
+  else if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
   {
-    result = read(myHandle, answer, max_size);
-    if(result == 0)
-      timeoutTick();
+    // The device has been unplugged (or the descriptor is no longer valid)
+    myLost = true;
+    return 0;
   }
-  return result;
-}
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-uInt32 SerialPortUNIX::sendBlock(const void* data, uInt32 size)
-{
-  return myHandle ? write(myHandle, data, size) : 0;
+  ssize_t n = read(myHandle, answer, max_size);
+  if(n < 0 && (errno == EIO || errno == ENXIO || errno == ENODEV))
+    myLost = true;
+  return n > 0 ? uInt32(n) : 0;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void SerialPortUNIX::setTimeout(uInt32 timeout_milliseconds)
+uInt32 SerialPortUNIX::sendVector(const Segment* segments, uInt32 count)
 {
-  mySerialTimeoutCount = timeout_milliseconds / 100;
+  if(!myHandle || myLost)
+    return 0;
+
+  struct iovec iov[MAX_SEGMENTS];
+  count = std::min(count, MAX_SEGMENTS);
+  for(uInt32 i = 0; i < count; ++i)
+  {
+    iov[i].iov_base = const_cast<void*>(segments[i].data);
+    iov[i].iov_len  = segments[i].size;
+  }
+
+  // The port is non-blocking; when its buffer is full (or output is held
+  // by flow control), wait for room, but never past the current deadline
+  struct pollfd pfd;
+  pfd.fd = myHandle;
+  pfd.events = POLLOUT;
+  for(;;)
+  {
+    pfd.revents = 0;
+    int ready = poll(&pfd, 1, int((timeRemaining() + 999) / 1000));
+    if(ready < 0 && errno == EINTR)
+      continue;
+    else if(ready <= 0)
+      return 0;
+    else if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+    {
+      myLost = true;
+      return 0;
+    }
+
+    ssize_t n = writev(myHandle, iov, int(count));
+    if(n > 0)
+      return uInt32(n);
+    else if(n < 0 && (errno == EIO || errno == ENXIO || errno == ENODEV))
+    {
+      myLost = true;
+      return 0;
+    }
+    else if((n < 0 && errno != EAGAIN && errno != EINTR) || timeoutCheck())
+      return 0;
+  }
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -213,6 +303,13 @@ const StringList& SerialPortUNIX::getPortNames()
 {
   myPortNames.clear();
 
+#if defined(__linux__)
+  // Linux describes every tty in sysfs, so ports can be found (and
+  // phantom ones discarded) without opening any of them
+  if(getPortNamesSysfs())
+    return myPortNames;
+#endif
+
   // First get all possible devices in the '/dev' directory
   DIR* dirp = opendir("/dev");
   if(dirp != NULL)
@@ -244,3 +341,98 @@ const StringList& SerialPortUNIX::getPortNames()
 
   return myPortNames;
 }
+
+#if defined(__linux__)
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Read the first line of a (small) sysfs attribute file
+static string readSysfs(const string& path)
+{
+  std::ifstream in(path);
+  string line;
+  if(in)
+    std::getline(in, line);
+  return line;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Resolve a sysfs symlink to its absolute target ("" if it doesn't exist)
+static string resolveSysfs(const string& path)
+{
+  char resolved[PATH_MAX];
+  return realpath(path.c_str(), resolved) != NULL ? string(resolved) : "";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortUNIX::getPortNamesSysfs()
+{
+  DIR* dirp = opendir("/sys/class/tty");
+  if(dirp == NULL)
+    return false;
+
+  // USB serial adapters known to be used with the KrokCart (vendor, product)
+  static constexpr uInt16 KnownAdapters[][2] = {
+    { 0x0403, 0x6001 },  // FTDI FT232R
+    { 0x0403, 0x6015 },  // FTDI FT-X series
+    { 0x067b, 0x2303 },  // Prolific PL2303
+    { 0x10c4, 0xea60 },  // Silicon Labs CP210x
+    { 0x1a86, 0x7523 }   // WCH CH340
+  };
+
+  vector<std::pair<int, string>> ports;  // (rank, device)
+  struct dirent* dp;
+  while((dp = readdir(dirp)) != NULL)
+  {
+    const char* ptr = dp->d_name;
+    if(!((strstr(ptr, "ttyS") == ptr) ||    // linux Serial Ports
+         (strstr(ptr, "ttyUSB") == ptr) ||  // for USB frobs
+         (strstr(ptr, "ttyACM") == ptr)))   // USB CDC modems
+      continue;
+
+    // Virtual terminals have no device behind them
+    string sysfs = string("/sys/class/tty/") + ptr;
+    string device = resolveSysfs(sysfs + "/device");
+    if(device == "")
+      continue;
+
+    // Legacy UARTs are registered whether or not the hardware is present;
+    // the core marks those that weren't detected as type 0 (unknown)
+    string type = readSysfs(sysfs + "/type");
+    if(type != "" && BSPF::stoi(type) == 0)
+      continue;
+
+    // Walk up the device hierarchy looking for the USB device, if any
+    uInt16 vendor = 0, product = 0;
+    for(string dir = device; dir.length() > 13; dir = dir.substr(0, dir.rfind('/')))
+    {
+      string id = readSysfs(dir + "/idVendor");
+      if(id != "")
+      {
+        vendor  = BSPF::stoi<16>(id);
+        product = BSPF::stoi<16>(readSysfs(dir + "/idProduct"));
+        break;
+      }
+    }
+
+    // Known adapters first, then any other USB device, then real UARTs
+    int rank = vendor != 0 ? 1 : 2;
+    for(const auto& adapter: KnownAdapters)
+      if(adapter[0] == vendor && adapter[1] == product)
+        rank = 0;
+
+    string driver = resolveSysfs(device + "/driver");
+    driver = driver.substr(driver.rfind('/') + 1);
+    if(driver == "" && vendor == 0)  // No driver bound, nothing to talk to
+      continue;
+
+    ports.emplace_back(rank, string("/dev/") + ptr);
+  }
+  closedir(dirp);
+
+  std::stable_sort(ports.begin(), ports.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+  for(const auto& port: ports)
+    myPortNames.push_back(port.second);
+
+  return true;
+}
+#endif
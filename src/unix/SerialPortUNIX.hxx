@@ -52,9 +52,8 @@ class SerialPortUNIX : public SerialPort
 
     /**
       Receives a buffer from the open com port. Returns all the characters
-      ready (waits for up to 'n' milliseconds before accepting that no more
-      characters are ready) or when the buffer is full. 'n' is system dependent,
-      see SerialTimeout routines.
+      ready, waiting no longer than the deadline set by setTimeout() for
+      the first one to arrive, or when the buffer is full.
 
       @param answer    Buffer to hold the bytes read from the serial port
       @param max_size  The size of buffer pointed to by answer
@@ -63,25 +62,15 @@ class SerialPortUNIX : public SerialPort
     uInt32 receiveBlock(void* answer, uInt32 max_size) override;
 
     /**
-      Write block of bytes to the serial port.
+      Write as many of the given segments as the port will accept in one
+      go (with a single writev), waiting no longer than the deadline set
+      by setTimeout() for it to accept anything at all.
 
-      @param data  The byte(s) to write to the port
-      @param size  The size of the block
+      @param segments  The data to write
+      @param count     The number of segments
       @return  The number of bytes written
     */
-    uInt32 sendBlock(const void* data, uInt32 size) override;
-
-    /**
-      Sets (or resets) the timeout to the timout period requested.  Starts
-      counting to this period.  This timeout support is a little odd in that
-      the timeout specifies the accumulated deadtime waiting to read not the
-      total time waiting to read. They should be close enough to the same for
-      this use. Used by the serial input routines, the actual counting takes
-      place in receiveBlock.
-
-      @param timeout_milliseconds  The time in milliseconds to use for timeout
-    */
-    void setTimeout(uInt32 timeout_milliseconds) override;
+    uInt32 sendVector(const Segment* segments, uInt32 count) override;
 
     /**
       Empty the serial port buffers.  Cleans things to a known state.
@@ -107,6 +96,18 @@ class SerialPortUNIX : public SerialPort
     */
     const StringList& getPortNames() override;
 
+  private:
+  #if defined(__linux__)
+    /**
+      Get all serial ports from sysfs, ranking USB adapters known to be
+      used with the KrokCart first.  Ports that have no hardware behind
+      them are skipped without being opened.
+
+      @return  False if sysfs isn't available, else true
+    */
+    bool getPortNamesSysfs();
+  #endif
+
   private:
     // File descriptor for serial connection
     int myHandle{0};
@@ -0,0 +1,45 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#if defined(__linux__)
+  #include <asm/termbits.h>
+  #include <sys/ioctl.h>
+#endif
+
+#include "Termios2.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool setTermios2Baud(int handle, uInt32 baud)
+{
+#if defined(__linux__) && defined(BOTHER)
+  struct termios2 tio;
+  if(ioctl(handle, TCGETS2, &tio) != 0)
+    return false;
+
+  tio.c_cflag &= ~CBAUD;
+  tio.c_cflag |= BOTHER;
+  tio.c_ispeed = tio.c_ospeed = baud;
+  if(ioctl(handle, TCSETS2, &tio) != 0)
+    return false;
+
+  // The driver may round the rate to whatever its clock divider allows;
+  // anything more than 3% off won't work reliably with a UART
+  if(ioctl(handle, TCGETS2, &tio) != 0)
+    return false;
+  uInt32 diff = tio.c_ospeed > baud ? tio.c_ospeed - baud : baud - tio.c_ospeed;
+  return diff * 100 <= baud * 3;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,34 @@
+//============================================================================
+//
+//  K   K  RRRR    OOO   K   K   CCCC   OOO   M   M
+//  K  K   R   R  O   O  K  K   C      O   O  MM MM
+//  KKK    RRRR   O   O  KKK    C      O   O  M M M  "Krokodile Cart software"
+//  K  K   R R    O   O  K  K   C      O   O  M   M
+//  K   K  R  R    OOO   K   K   CCCC   OOO   M   M
+//
+// Copyright (c) 2009-2025 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef TERMIOS2_HXX
+#define TERMIOS2_HXX
+
+#include "bspf.hxx"
+
+/**
+  Set an arbitrary baud rate on an already configured serial port, using
+  the Linux 'termios2' interface and the BOTHER flag.
+
+  This lives in its own file since the kernel termios2 definitions
+  clash with those from <termios.h>.
+
+  @param handle  The file descriptor of the open serial port
+  @param baud    The requested transfer rate
+  @return  False if the rate couldn't be set (or the driver chose a rate
+           that differs too much from the one requested), else true
+*/
+bool setTermios2Baud(int handle, uInt32 baud);
+
+#endif